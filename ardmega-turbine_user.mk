@@ -26,6 +26,9 @@ ardmega-turbine_USER_CSRC = \
 	$(ardmega-turbine_SRC_PATH)/median.c \
 	$(ardmega-turbine_SRC_PATH)/eeprommap.c \
 	$(ardmega-turbine_SRC_PATH)/minmax.c \
+	$(ardmega-turbine_SRC_PATH)/rollup.c \
+	$(ardmega-turbine_SRC_PATH)/curvetab.c \
+	$(ardmega-turbine_SRC_PATH)/owdev.c \
 	#
 
 # Files included by the user.
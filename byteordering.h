@@ -43,9 +43,9 @@ extern "C"
                      ((((uint32_t) (val)) & 0xff000000) >> 24)   \
                     )
 
-#if LITTLE_ENDIAN || __AVR__
+#if LITTLE_ENDIAN || __AVR__ || (defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
 #define SWAP_NEEDED 0
-#elif BIG_ENDIAN
+#elif BIG_ENDIAN || (defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
 #define SWAP_NEEDED 1
 #else
 #error "Endianess undefined! Please define LITTLE_ENDIAN=1 or BIG_ENDIAN=1."
@@ -24,13 +24,14 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <stdlib.h>
-#include <math.h>
 #include <avr/io.h>
 #include <avr/eeprom.h>
 #include <avr/pgmspace.h>
 
 #include <algo/crc8.h>
 
+#include <cpu/irq.h>
+
 #include <drv/timer.h>
 #include <drv/ser.h>
 #include <drv/ow_1wire.h>
@@ -45,6 +46,8 @@
 #include "measure.h"
 #include "eeprommap.h"
 #include "control.h"
+#include "fixed.h"
+#include "curve.h"
 
 extern Serial serial;
 
@@ -73,6 +76,15 @@ int16_t gDischarge;
 int16_t gMaxDischarge;
 int16_t gRPMMax;
 int16_t gRPMSafe;
+int16_t gCurve;
+int16_t gRegMode;
+int16_t gKp;
+int16_t gKi;
+int16_t gKd;
+int16_t gSlew;
+volatile uint16_t gCtlLate;			  // all three written by control_tick
+volatile uint16_t gCtlWorst;
+volatile uint16_t gCtlMissed;
 
 int16_t TargetC;
 uint8_t command = 0;
@@ -90,42 +102,382 @@ enum CHARGE
 
 #define PRESCALE ((1 << CS11))
 
+#define CONTROL_PERIOD 50L        // period of the control tick in mS
+#define CONTROL_LATE   1          // ticks of jitter allowed before the control tick counts as late
 
-// press the start/stop button on the inverter remote control and wait for the indicator
-// LED to go ON or OFF to show success (done by relay and opto coupler)
-static char
-ToggleState(uint8_t * id, uint8_t state)
+// measurements and settings latched by the main loop for the control tick. The tick runs from the
+// timer interrupt so it must only ever see a complete set, never one half way through being updated
+typedef struct
+{
+	int16_t volts;                 // instantaneous volts
+	int16_t hi;                    // top of the shunt range
+	int16_t lo;                    // bottom of the shunt range
+	int16_t set;                   // target volts for the PI regulator
+	int16_t rpm;
+	int16_t rpmmax;
+	int16_t rpmsafe;
+	int16_t mode;                  // 1 for PI, else curve
+	int16_t curve;
+	int16_t kp, ki, kd, slew;
+	bool fresh;                    // latched since the last tick
+} CTL_SNAP;
+
+static volatile CTL_SNAP snap;
+static volatile uint16_t tick_duty;   // PWM value set by the tick
+static volatile uint8_t stop_state = RUNNING;   // turbine shutdown, moved on by the tick
+static Timer control_timer;
+static ticks_t control_due;
+
+// PI regulator state
+static int32_t reg_integral;      // integral term in 1/256ths of a PWM count
+static int16_t reg_last_volts;    // volts at the last sample for the derivative term
+static int16_t reg_duty;          // PWM value currently applied
+static int16_t reg_last_mode;
+
+
+// look up the dump load duty (times CURVE_SCALE) for a voltage error of diff over a shunt range of range,
+// interpolating between the table points
+static uint16_t
+curve_duty (uint16_t diff, uint16_t range, int16_t shape)
 {
+	const uint16_t *table;
+	uint32_t pos;
+	uint16_t index, lo, hi;
+	uint8_t frac;
+
+	// past the top of the range (or no range at all) is flat out
+	if (diff >= range)
+		return (uint16_t) CURVE_TOP * CURVE_SCALE;
+
+	// position along the table in 1/256ths of a step
+	pos = ((uint32_t) diff << 16) / range;
+	index = pos >> 8;
+	frac = pos & 0xff;
+
+	table = curve_table[(shape >= 0 && shape < CURVE_SHAPES) ? shape : ddCurve];
+	lo = pgm_read_word (&table[index]);
+	hi = pgm_read_word (&table[index + 1]);
+	return lo + (uint16_t) (((uint32_t) (hi - lo) * frac) >> 8);
+}
 
-	uint8_t expected, read;
 
-	if (gpioid == -1)				  // see if a DS2413 chip is present
-		return true;				  // fake success
+// one sample of the PI(D) regulator. The error is in volts * 100 and is positive when the volts are
+// above target so needs more dump load. Gains are PWM counts per volt (Kp), per volt-second (Ki)
+// and per volt/second (Kd), the slew limit is in PWM counts per second
+static void
+pi_duty (int16_t volts, int16_t target)
+{
+	int16_t err = volts - target;
+	int32_t out, integral;
+	int16_t step;
+
+	// proportional, and derivative on the measurement so a change of target doesn't kick the load
+	out = ((int32_t) snap.kp * err) / 100;
+	out += ((int32_t) snap.kd * (volts - reg_last_volts) * (1000 / CONTROL_PERIOD)) / 100;
+	reg_last_volts = volts;
+
+	// anti-windup: don't integrate upwards while the output is already flat out and keep the
+	// integral itself within the output range
+	integral = reg_integral + ((int32_t) snap.ki * err * 256) / (100 * (1000 / CONTROL_PERIOD));
+	if (err < 0 || out + reg_integral / 256 < CURVE_TOP)
+	{
+		if (integral < 0)
+			integral = 0;
+		if (integral > (int32_t) CURVE_TOP * 256)
+			integral = (int32_t) CURVE_TOP * 256;
+		reg_integral = integral;
+	}
+	out += reg_integral / 256;
+
+	// as with the curve, never go right up to 100% so the load is still pulsing
+	if (out < 0)
+		out = 0;
+	if (out > CURVE_TOP)
+		out = CURVE_TOP;
+
+	// limit how fast the load can change so the resistors aren't cycled hard in gusts
+	step = ((int32_t) snap.slew * CONTROL_PERIOD) / 1000;
+	if (step < 1)
+		step = 1;
+	if (out > reg_duty + step)
+		out = reg_duty + step;
+	if (out < reg_duty - step)
+		out = reg_duty - step;
+
+	reg_duty = out;
+}
 
-	read = ow_ds2413_read(id);
+
+// the control tick, run from the timer interrupt every CONTROL_PERIOD whatever the main loop is
+// doing (1-wire conversions, SD card writes...). Sets the shunt PWM and does the overspeed shutdown from the
+// last latched measurements, the slow stuff that follows on from that is left to run_control
+static void
+control_tick (void *arg)
+{
+	ticks_t now = timer_clock_unlocked ();
+	int32_t late;
+	int16_t diff;
+	uint16_t duty;
+
+	(void) arg;
+
+	// re-arm first so the period doesn't stretch by however long we take
+	timer_add (&control_timer);
+
+	// count it if the interrupts were held off long enough to make us late (and keep the worst),
+	// or if the main loop hasn't got round to giving us new figures since last time
+	late = (int32_t) (now - control_due);
+	if (late > CONTROL_LATE)
+		gCtlLate++;
+	if (late > (int32_t) gCtlWorst)
+		gCtlWorst = late > UINT16_MAX ? UINT16_MAX : late;
+	control_due = now + ms_to_ticks (CONTROL_PERIOD);
+	if (!snap.fresh)
+		gCtlMissed++;
+	snap.fresh = false;
+
+	if (snap.mode == 1)
+	{
+		// closed loop - hold the volts at the target for the charge mode
+		if (reg_last_mode != 1)
+		{
+			// pick up from whatever the curve was doing so the load doesn't jump
+			reg_duty = tick_duty;
+			reg_integral = (int32_t) reg_duty * 256;
+			reg_last_volts = snap.volts;
+		}
+		pi_duty (snap.volts, snap.set);
+		duty = reg_duty;
+	}
+	else
+	{
+		// see if we are above shunt load threshold - use instantanious volts, not the average
+		diff = snap.volts - snap.lo;
+		if (diff > 0)
+		{
+			// use log application of dump load over the range we're operating the PWM. The curve
+			// tops out at 1010 so the load is always still pulsing in case we are using AC coupling!!
+			duty = curve_duty (diff, snap.hi - snap.lo, snap.curve) / CURVE_SCALE;
+		}
+		else
+			duty = 0;
+	}
+	reg_last_mode = snap.mode;
+
+	// Do a total turbine shutdown if RPMs exceed max value
+	//   make sure that RPMs drop to a safe value before applying brake!
+	if ((stop_state == STOPPING) && (snap.rpm < snap.rpmsafe))
+		stop_state = BREAKING;
+	else if (snap.rpm > snap.rpmmax)
+		stop_state = STOPPING;
+	else if ((stop_state == BREAKING) && (snap.rpm == 0))
+		stop_state = STOPPED;
+
+	// load the turbine right up to slow it down while stopping (still pulsing, as for the curve). The
+	// PI regulator starts again from here afterwards
+	if (stop_state == STOPPING)
+	{
+		duty = CURVE_TOP;
+		reg_last_mode = -1;
+	}
+
+	OCR1A = duty;
+	tick_duty = duty;
+}
+
+
+static void
+set_charge_target(void)
+{
+	if ((gDischarge >= gMaxDischarge) || (gDischarge < 0))
+	{
+		TargetC = gBankSize;
+		gDischarge = 0;
+	}
+	else
+	{
+		TargetC = gMaxCharge;
+		gDischarge++;
+	}
+}
+
+
+// pressing the start/stop button on the inverter remote control (done by relay and opto coupler) and
+// waiting for the indicator LED to go ON or OFF to show success takes the best part of a second, so it
+// is done a step at a time on successive passes of run_control instead of holding everything else up
+#define TOGGLE_PRESS   500L       // how long to hold the button down in mS
+#define TOGGLE_SETTLE  150L       // time for the LED to come on or go off in mS
+#define TOGGLE_VERIFY 1000L       // give up on a press if the LED hasn't changed by this long after release
+#define TOGGLE_TRIES     3        // presses before reporting failure
+
+enum ToggleStates
+{
+	TOGGLE_IDLE,
+	TOGGLE_HOLD,
+	TOGGLE_SETTLE_WAIT,
+	TOGGLE_VERIFY_WAIT
+};
+
+static uint8_t toggle_state = TOGGLE_IDLE;
+static uint8_t toggle_expected;   // DS2413 state once switched
+static uint8_t toggle_reason;     // log event of what we switched for, LOG_NULL for none
+static uint8_t toggle_tries;
+static ticks_t toggle_timer;
+
+
+// finish off whatever the inverter was being switched for
+static void
+toggle_done(bool ok)
+{
+	toggle_state = TOGGLE_IDLE;
+
+	if (!ok)
+	{
+		// error
+		if (toggle_reason != LOG_NULL)
+			log_event(toggle_reason | LOG_ERROR);
+		return;
+	}
+
+	switch (toggle_reason)
+	{
+	case LOG_MANUALOFF:
+		// turned off load OK, start charging
+		gLoad = LOADOFF;
+		log_event(LOG_MANUALOFF);
+		set_charge_target();
+		break;
+
+	case LOG_MANUALON:
+		gLoad = LOADON;
+		log_event(LOG_MANUALON);
+		// define point to which we discharge to
+		TargetC = 0;
+		break;
+
+	case LOG_UNDERVOLT:
+		log_event(LOG_UNDERVOLT);
+		// turned off load OK, start charging
+		gLoad = LOADOFF;
+		TargetC = gBankSize;
+		break;
+
+	case LOG_OVERVOLT:
+		// turn on load
+		gLoad = LOADON;
+		log_event(LOG_OVERVOLT);
+		// set the target level to discharge to a small amount below the current value so we don't keep the load on for too long
+		TargetC = fix_scale(gCharge, FIX(0.99));
+		break;
+
+	case LOG_CHARGED:
+		// turn on load
+		gLoad = LOADAUTO;
+		log_event(LOG_CHARGED);
+		TargetC = gMinCharge;
+		break;
+
+	case LOG_DISCHARGED:
+		// turned off load OK, start charging
+		gLoad = LOADOFF;
+		log_event(LOG_DISCHARGED);
+		// decide whether we are doing a normal charge or we are taking up to full float level
+		set_charge_target();
+		eeprom_write_block ((const void *) &gDischarge, (void *) &eeDischarge, sizeof(gDischarge));
+		break;
+	}
+}
+
+
+// press the button, or give up if we've already tried enough times
+static void
+toggle_press(void)
+{
+	if (toggle_tries >= TOGGLE_TRIES)
+	{
+		toggle_done(false);
+		return;
+	}
+	if (toggle_tries++ > 0)
+		owdev_retry(gpioid);
+	if (!ow_ds2413_write(owdev[gpioid].rom, 2)) // set PIOA
+	{
+		owdev_failed(gpioid);
+		toggle_done(false);
+		return;
+	}
+	owdev_ok(gpioid);
+	toggle_timer = timer_clock ();
+	toggle_state = TOGGLE_HOLD;
+}
+
+
+// start switching the inverter on or off. reason is the log event to finish off with in toggle_done
+static void
+toggle_start(uint8_t state, uint8_t reason)
+{
+	toggle_reason = reason;
+	toggle_tries = 0;
+
+	if (gpioid == -1)				  // see if a DS2413 chip is present
+	{
+		toggle_done(true);			  // fake success
+		return;
+	}
 
 	if (state)
-		expected = 0x4b;			  // state after toggling
+		toggle_expected = 0x4b;			  // state after toggling
 	else
-		expected = 0x0f;
+		toggle_expected = 0x0f;
 
 	// if already in the correct state then no need to 'press' the switch
-	if (read == expected)
-		return true;
-
-	if (!ow_ds2413_write(id, 2)) // set PIOA
-		return false;
-	timer_delay(500);
-	if (!ow_ds2413_write(id, 3)) // clear PIOA
-		return false;
-
-	// allow time for the LED to come on or go off
-	timer_delay(150);
-	read = ow_ds2413_read(id);	  // read again
-	if (read == expected)
-		return true;
-	else
-		return false;
+	if (ow_ds2413_read(owdev[gpioid].rom) == toggle_expected)
+	{
+		toggle_done(true);
+		return;
+	}
+
+	toggle_press();
+}
+
+
+// move an inverter switch on a step
+static void
+run_toggle(void)
+{
+	switch (toggle_state)
+	{
+	case TOGGLE_HOLD:
+		if (timer_clock () - toggle_timer < ms_to_ticks (TOGGLE_PRESS))
+			break;
+		if (!ow_ds2413_write(owdev[gpioid].rom, 3)) // clear PIOA
+		{
+			owdev_failed(gpioid);
+			// try again from the top, the button may or may not have been let go of
+			if (ow_ds2413_read(owdev[gpioid].rom) == toggle_expected)
+				toggle_done(true);
+			else
+				toggle_press();
+			break;
+		}
+		toggle_timer = timer_clock ();
+		toggle_state = TOGGLE_SETTLE_WAIT;
+		break;
+
+	case TOGGLE_SETTLE_WAIT:
+		// allow time for the LED to come on or go off
+		if (timer_clock () - toggle_timer < ms_to_ticks (TOGGLE_SETTLE))
+			break;
+		toggle_state = TOGGLE_VERIFY_WAIT;
+		// fall through
+
+	case TOGGLE_VERIFY_WAIT:
+		if (ow_ds2413_read(owdev[gpioid].rom) == toggle_expected)
+			toggle_done(true);
+		else if (timer_clock () - toggle_timer >= ms_to_ticks (TOGGLE_VERIFY))
+			toggle_press();          // didn't take, press it again
+		break;
+	}
 }
 
 
@@ -158,9 +510,17 @@ control_init(void)
 	// Set a initial value in the OCR1A-register
 	OCR1A = 0;
 
+	// start the control tick, it re-arms itself each time
+	timer_setSoftint (&control_timer, control_tick, NULL);
+	timer_setDelay (&control_timer, ms_to_ticks (CONTROL_PERIOD));
+	ATOMIC(
+		control_due = timer_clock_unlocked () + ms_to_ticks (CONTROL_PERIOD);
+		timer_add (&control_timer);
+	);
+
 	// see if a DS2413 chip is present so we can ensure we start at a known state
 	if (gpioid >= 0)
-		ToggleState(ids[gpioid], false);
+		toggle_start(false, LOG_NULL);
 
 	eeprom_read_block ((void *) &gDischarge, (const void *) &eeDischarge, sizeof(gDischarge));
 	if (gDischarge <= 0)
@@ -171,25 +531,7 @@ control_init(void)
 }
 
 
-static void
-set_charge_target(void)
-{
-	if ((gDischarge >= gMaxDischarge) || (gDischarge < 0))
-	{
-		TargetC = gBankSize;
-		gDischarge = 0;
-	}
-	else
-	{
-		TargetC = gMaxCharge;
-		gDischarge++;
-	}
-}
-
-
 // control a dump load that is used when the battery bank is full
-// Do a total turbine shutdown if RPMs exceed max value
-//   make sure that RPMs drop to a safe value before applying brake!
 // Also used for last resort overvolt protection
 void
 run_control(void)
@@ -197,18 +539,20 @@ run_control(void)
 	// locals
 	int16_t VoltsHI = 0;
 	int16_t VoltsLO = 0;
-	int16_t diff;
-	uint16_t range = 0;
+	int16_t VoltsSet = 0;
+	uint16_t duty;
+	uint8_t state;
 	static bool log_reported = false;
-	static uint8_t stop_state = RUNNING;
+	static uint8_t last_state = RUNNING;
 
 	// decide what charging mode we are in.
-	if (gCharge < (gBankSize * 0.90))
+	if (gCharge < fix_scale(gBankSize, FIX(0.90)))
 	{
 		charge_mode = BULK;
 		// only run shunt if volts gets stupidly high!
 		VoltsHI = gVupper;
-		VoltsLO = gVupper * 0.98;
+		VoltsLO = fix_scale(gVupper, FIX(0.98));
+		VoltsSet = VoltsLO;
 	}
 	else if (gCharge < gBankSize)
 	{
@@ -216,40 +560,46 @@ run_control(void)
 		// start throttling back once over float volts, never go above absorb volts
 		VoltsHI = gAbsorbVolts;
 		VoltsLO = gFloatVolts;
+		VoltsSet = gAbsorbVolts;
 	}
 	else
 	{
 		charge_mode = FLOAT;
 		// never go above float volts, but allow a bit of slack
 		VoltsHI = gFloatVolts;
-		VoltsLO = (int16_t)((float)gFloatVolts * 0.98);
+		VoltsLO = fix_scale(gFloatVolts, FIX(0.98));
+		VoltsSet = gFloatVolts;
 	}
 
 	// compensate for temperature - assume set values are for 25C, adjust accordingly
 	// the higher the temp, the lower the volts by 5mV per deg C
 	// Tricky calculation as both volts and temperature are scaled by 100
-	VoltsHI -= 0.005 * (gTemp - 2500);
-	VoltsLO -= 0.005 * (gTemp - 2500);
-
-	// see if we are above shunt load threshold - use instantanious volts, not the average
-	diff = iVolts - VoltsLO;
-	if (diff > 0)
+	VoltsHI = fix_sub_sat(VoltsHI, fix_scale(gTemp - 2500, FIX(0.005)));
+	VoltsLO = fix_sub_sat(VoltsLO, fix_scale(gTemp - 2500, FIX(0.005)));
+	VoltsSet = fix_sub_sat(VoltsSet, fix_scale(gTemp - 2500, FIX(0.005)));
+
+	// hand the latest figures to the control tick and pick up what it did with the last lot
+	ATOMIC(
+		snap.volts = iVolts;
+		snap.hi = VoltsHI;
+		snap.lo = VoltsLO;
+		snap.set = VoltsSet;
+		snap.rpm = gRPM;
+		snap.rpmmax = gRPMMax;
+		snap.rpmsafe = gRPMSafe;
+		snap.mode = gRegMode;
+		snap.curve = gCurve;
+		snap.kp = gKp;
+		snap.ki = gKi;
+		snap.kd = gKd;
+		snap.slew = gSlew;
+		snap.fresh = true;
+		duty = tick_duty;
+	);
+
+	if (duty > 0)
 	{
-		// see what range we're operating the PWM over
-		range = VoltsHI - VoltsLO;
-		// use log application of dump load
-#define SHAPE 63
-		float dval = (float)diff / range;
-		float fig = log(SHAPE);
-		float regval = 1010 * (exp(fig * dval) - 1) / (SHAPE - 1);
-
-		// if above the top value then set near max on time but make sure its still pulsing
-		// in case we are using AC coupling!!
-		if (regval > 1010)
-			regval = 1010;
-
-		OCR1A = (uint16_t) regval;
-		gDump = regval / 10;	  // shunt load is activated - show initial value
+		gDump = duty / 10;	  // shunt load is activated - show initial value
 		if (!log_reported && gDump >= 50)				  // if going from OFF to ON then log the event
 		{
 			log_event(LOG_SHUNTON);
@@ -258,7 +608,6 @@ run_control(void)
 	}
 	else
 	{
-		OCR1A = 0;
 		gDump = 0;
 		if (log_reported)
 		{
@@ -279,22 +628,22 @@ run_control(void)
 		command = 0;
 	}
 
-
-	if ((stop_state == STOPPING) && (gRPM < gRPMSafe))
-	{
+	// the tick decides when to stop and brake, all that's left here is to do it. The tick may have gone
+	// on from BREAKING to STOPPED before we get here so look for either
+	state = stop_state;
+	if (((state == BREAKING) || (state == STOPPED)) && (last_state != BREAKING) && (last_state != STOPPED))
 		apply_brake(true);
-		stop_state = BREAKING;
-	}
-	else if (gRPM > gRPMMax)
-	{
-		stop_state = STOPPING;
-	}
-	else if ((stop_state == BREAKING) && (gRPM == 0))
+	last_state = state;
+
+
+	// carry on with switching the inverter if we're part way through. Nothing else
+	// gets switched until that has finished
+	if (toggle_state != TOGGLE_IDLE)
 	{
-		stop_state = STOPPED;
+		run_toggle();
+		return;
 	}
 
-
 	// see if we have an inverter we can control
 	if (gInverter == 0)
 		return;
@@ -303,18 +652,7 @@ run_control(void)
 	if (command == MANUALOFF)
 	{
 		command = 0;
-		if (ToggleState(ids[gpioid], false))
-		{
-			// turned off load OK, start charging
-			gLoad = LOADOFF;
-			log_event(LOG_MANUALOFF);
-			set_charge_target();
-		}
-		else
-		{
-			// error
-			log_event(LOG_MANUALOFF | LOG_ERROR);
-		}
+		toggle_start(false, LOG_MANUALOFF);
 	}
 
 	// we assume that the user knows what they are doing here!!
@@ -322,37 +660,20 @@ run_control(void)
 	if (command == MANUALON)
 	{
 		command = 0;
-		if (ToggleState(ids[gpioid], true))
-		{
-			gLoad = LOADON;
-			log_event(LOG_MANUALON);
-			// define point to which we discharge to
-			TargetC = 0;
-		}
-		else
-		{
-			// error
-			log_event(LOG_MANUALON | LOG_ERROR);
-		}
+		toggle_start(true, LOG_MANUALON);
 	}
 
+	if (toggle_state != TOGGLE_IDLE)
+		return;
+
 
 	// if volts are below set minimum then cut the load whatever the charge state is and start charging again
 	// this ensures a retry at shutoff in case we get a failure (sticky relay etc)
 	if (gVolts < gVlower)
 	{
-		if (ToggleState(ids[gpioid], false))
-		{
-			log_event(LOG_UNDERVOLT);
-			// turned off load OK, start charging
-			gLoad = LOADOFF;
-			TargetC = gBankSize;
-		}
-		else
-		{
-			//error
-			log_event(LOG_UNDERVOLT | LOG_ERROR);
-		}
+		toggle_start(false, LOG_UNDERVOLT);
+		if (toggle_state != TOGGLE_IDLE)
+			return;
 	}
 
 	// see if we have an inverter we allow automatic control of
@@ -365,63 +686,19 @@ run_control(void)
 	{
 		// if volts is above the set maximum apply load to try and pull the volts down - leave load on for only a short while
 		if (gVolts > gVupper)
-		{
-			if (ToggleState(ids[gpioid], true))
-			{
-				// turn on load
-				gLoad = LOADON;
-				log_event(LOG_OVERVOLT);
-				// set the target level to discharge to a small amount below the current value so we don't keep the load on for too long
-				TargetC = (int16_t)((float)gCharge * 0.99);
-			}
-			else
-			{
-				//error
-				log_event(LOG_OVERVOLT | LOG_ERROR);
-			}
-		}
+			toggle_start(true, LOG_OVERVOLT);
 		// if we have reached our target charge level then start normal discharge cycle
 		else if (gCharge >= TargetC)
-		{
-			if (ToggleState(ids[gpioid], true))
-			{
-				// turn on load
-				gLoad = LOADAUTO;
-				log_event(LOG_CHARGED);
-				TargetC = gMinCharge;
-			}
-			else
-			{
-				// error
-				log_event(LOG_CHARGED | LOG_ERROR);
-			}
-		}
+			toggle_start(true, LOG_CHARGED);
 	}
 	// the load is already on or auto
 	else
 	{
 		// if we have reached our target discharge level then start normal charge cycle
 		if (gCharge <= TargetC)
-		{
-			if (ToggleState(ids[gpioid], false))
-			{
-				// turned off load OK, start charging
-				gLoad = LOADOFF;
-				log_event(LOG_DISCHARGED);
-				// decide whether we are doing a normal charge or we are taking up to full float level
-				set_charge_target();
-				eeprom_write_block ((const void *) &gDischarge, (void *) &eeDischarge, sizeof(gDischarge));
-			}
-			else
-			{
-				// error
-				log_event(LOG_DISCHARGED | LOG_ERROR);
-			}
-		}
+			toggle_start(false, LOG_DISCHARGED);
 	}
 
-
-
 }
 
 // manual operation of the inverter through the UI
@@ -52,6 +52,15 @@ extern int16_t gDischarge;
 extern int16_t gMaxDischarge;
 extern int16_t gRPMMax;
 extern int16_t gRPMSafe;
+extern int16_t gCurve;
+extern int16_t gRegMode;
+extern int16_t gKp;
+extern int16_t gKi;
+extern int16_t gKd;
+extern int16_t gSlew;
+extern volatile uint16_t gCtlLate;
+extern volatile uint16_t gCtlWorst;
+extern volatile uint16_t gCtlMissed;
 
 
 void control_init (void);
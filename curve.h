@@ -0,0 +1,40 @@
+//---------------------------------------------------------------------------
+// Copyright (C) 2012 Robin Gilks
+//
+//
+//  curve.h   -   Lookup tables for the dump load PWM curve
+//
+//  History:   1.0 - First release. 
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+// 
+
+
+#ifndef _CURVE_H
+#define _CURVE_H
+
+#include <stdint.h>
+#include <avr/pgmspace.h>
+
+// The tables are made by tools/mkcurve.c into curvetab.c. Each one is the dump load duty (OCR1A, times
+// CURVE_SCALE) at CURVE_POINTS evenly spaced voltage errors from none to the whole of the shunt range.
+// The shapes are 15, 31, 63 and 127 - the bigger the shape, the later the load comes on hard.
+#define CURVE_SHAPES    4
+#define CURVE_POINTS    257
+#define CURVE_TOP       1010
+#define CURVE_SCALE     64
+
+extern const uint16_t curve_table[CURVE_SHAPES][CURVE_POINTS] PROGMEM;
+
+#endif
@@ -0,0 +1,108 @@
+// Generated by tools/mkcurve.c - do not edit, change that and run it again
+
+#include <avr/pgmspace.h>
+
+#include "curve.h"
+
+const uint16_t curve_table[CURVE_SHAPES][CURVE_POINTS] PROGMEM = {
+	// shape 15
+	{
+		    0,   49,   99,  149,  200,  251,  303,  355,  408,  461,  515,  570,
+		  625,  681,  737,  794,  851,  910,  968, 1028, 1088, 1149, 1210, 1272,
+		 1334, 1398, 1462, 1526, 1592, 1658, 1724, 1792, 1860, 1929, 1999, 2069,
+		 2140, 2212, 2284, 2358, 2432, 2507, 2583, 2659, 2737, 2815, 2894, 2974,
+		 3055, 3136, 3219, 3302, 3386, 3471, 3557, 3644, 3732, 3821, 3911, 4001,
+		 4093, 4186, 4279, 4374, 4469, 4566, 4664, 4762, 4862, 4963, 5065, 5168,
+		 5272, 5377, 5483, 5591, 5699, 5809, 5920, 6032, 6145, 6260, 6375, 6492,
+		 6610, 6730, 6850, 6972, 7095, 7220, 7346, 7473, 7602, 7732, 7863, 7996,
+		 8130, 8265, 8402, 8541, 8681, 8822, 8965, 9110, 9256, 9403, 9552, 9703,
+		 9855,10009,10165,10322,10481,10641,10803,10967,11133,11301,11470,11641,
+		11814,11989,12165,12344,12524,12706,12891,13077,13265,13455,13647,13842,
+		14038,14236,14437,14639,14844,15051,15260,15472,15685,15901,16119,16340,
+		16563,16788,17016,17246,17478,17713,17951,18191,18433,18678,18926,19176,
+		19429,19685,19944,20205,20469,20736,21005,21278,21553,21831,22113,22397,
+		22684,22974,23268,23564,23864,24167,24473,24782,25095,25411,25730,26053,
+		26379,26709,27042,27379,27719,28063,28410,28762,29117,29475,29838,30204,
+		30575,30949,31327,31709,32096,32486,32881,33279,33682,34090,34501,34917,
+		35338,35763,36192,36626,37065,37508,37956,38409,38866,39329,39796,40268,
+		40746,41228,41716,42208,42706,43210,43718,44232,44752,45277,45807,46344,
+		46886,47433,47987,48546,49112,49683,50260,50844,51434,52030,52632,53241,
+		53856,54478,55107,55742,56384,57032,57688,58351,59020,59697,60381,61072,
+		61771,62477,63190,63911,64640,
+	},
+	// shape 31
+	{
+		    0,   29,   59,   88,  119,  149,  181,  212,  244,  276,  309,  343,
+		  376,  410,  445,  480,  516,  552,  588,  625,  663,  701,  740,  779,
+		  818,  858,  899,  940,  982, 1025, 1068, 1111, 1155, 1200, 1245, 1291,
+		 1338, 1385, 1433, 1481, 1530, 1580, 1630, 1681, 1733, 1786, 1839, 1893,
+		 1947, 2003, 2059, 2116, 2174, 2232, 2291, 2351, 2412, 2474, 2536, 2600,
+		 2664, 2729, 2795, 2862, 2930, 2998, 3068, 3138, 3210, 3282, 3356, 3430,
+		 3505, 3582, 3659, 3738, 3817, 3898, 3980, 4063, 4147, 4232, 4318, 4405,
+		 4494, 4584, 4675, 4767, 4860, 4955, 5051, 5149, 5247, 5347, 5448, 5551,
+		 5655, 5761, 5868, 5976, 6086, 6197, 6310, 6424, 6540, 6657, 6776, 6897,
+		 7019, 7143, 7269, 7396, 7525, 7656, 7788, 7922, 8058, 8196, 8336, 8478,
+		 8621, 8767, 8914, 9064, 9215, 9369, 9524, 9682, 9842,10004,10168,10335,
+		10503,10674,10847,11023,11201,11381,11564,11749,11937,12128,12320,12516,
+		12714,12915,13118,13325,13534,13745,13960,14178,14398,14622,14848,15078,
+		15311,15547,15786,16028,16273,16522,16775,17030,17289,17552,17818,18088,
+		18361,18638,18919,19203,19492,19784,20080,20381,20685,20994,21306,21623,
+		21944,22269,22599,22934,23272,23616,23964,24317,24674,25036,25403,25776,
+		26153,26535,26923,27315,27713,28117,28525,28940,29360,29785,30216,30654,
+		31097,31546,32001,32462,32930,33403,33884,34370,34863,35363,35870,36383,
+		36904,37431,37966,38508,39057,39613,40177,40749,41329,41916,42511,43114,
+		43725,44345,44973,45609,46254,46908,47571,48242,48923,49613,50312,51020,
+		51738,52466,53204,53951,54709,55477,56255,57044,57843,58654,59475,60307,
+		61151,62005,62872,63750,64640,
+	},
+	// shape 63
+	{
+		    0,   17,   34,   52,   70,   88,  106,  125,  144,  163,  183,  203,
+		  223,  244,  265,  286,  308,  330,  353,  375,  398,  422,  446,  470,
+		  495,  520,  545,  571,  598,  624,  652,  679,  707,  736,  765,  794,
+		  824,  855,  886,  917,  949,  982, 1015, 1048, 1082, 1117, 1152, 1188,
+		 1225, 1262, 1299, 1337, 1376, 1416, 1456, 1497, 1538, 1580, 1623, 1666,
+		 1711, 1755, 1801, 1848, 1895, 1943, 1991, 2041, 2091, 2142, 2194, 2247,
+		 2301, 2355, 2411, 2467, 2524, 2582, 2642, 2702, 2763, 2825, 2888, 2952,
+		 3017, 3084, 3151, 3219, 3289, 3360, 3431, 3504, 3579, 3654, 3731, 3808,
+		 3888, 3968, 4050, 4133, 4217, 4303, 4390, 4479, 4569, 4661, 4754, 4848,
+		 4944, 5042, 5141, 5242, 5345, 5449, 5555, 5663, 5772, 5883, 5996, 6111,
+		 6228, 6346, 6467, 6589, 6714, 6840, 6969, 7100, 7233, 7368, 7505, 7644,
+		 7786, 7930, 8077, 8225, 8377, 8530, 8686, 8845, 9006, 9170, 9337, 9506,
+		 9679, 9853,10031,10212,10396,10582,10772,10965,11160,11360,11562,11768,
+		11977,12189,12405,12624,12847,13074,13304,13538,13776,14018,14264,14513,
+		14767,15025,15287,15554,15825,16100,16379,16664,16953,17246,17545,17848,
+		18156,18469,18788,19111,19440,19774,20114,20459,20810,21166,21529,21897,
+		22271,22652,23038,23431,23831,24236,24649,25068,25494,25927,26367,26814,
+		27269,27731,28200,28677,29162,29655,30156,30665,31182,31708,32242,32785,
+		33337,33898,34468,35048,35636,36235,36843,37461,38089,38728,39377,40036,
+		40707,41388,42080,42784,43499,44225,44964,45715,46477,47253,48041,48842,
+		49655,50483,51323,52178,53046,53929,54825,55737,56663,57605,58562,59534,
+		60523,61527,62548,63586,64640,
+	},
+	// shape 127
+	{
+		    0,   10,   20,   30,   40,   51,   62,   73,   84,   95,  107,  119,
+		  131,  143,  156,  168,  181,  195,  208,  222,  236,  250,  265,  280,
+		  295,  310,  326,  342,  358,  375,  392,  409,  427,  445,  463,  482,
+		  501,  520,  540,  560,  581,  601,  623,  644,  667,  689,  712,  735,
+		  759,  784,  808,  834,  859,  886,  912,  939,  967,  996, 1024, 1054,
+		 1084, 1114, 1145, 1177, 1209, 1242, 1276, 1310, 1345, 1380, 1416, 1453,
+		 1491, 1529, 1568, 1608, 1648, 1689, 1732, 1774, 1818, 1863, 1908, 1954,
+		 2001, 2049, 2098, 2148, 2199, 2251, 2304, 2358, 2412, 2468, 2525, 2583,
+		 2642, 2703, 2764, 2827, 2891, 2956, 3022, 3089, 3158, 3228, 3300, 3373,
+		 3447, 3522, 3600, 3678, 3758, 3840, 3923, 4008, 4094, 4182, 4272, 4363,
+		 4456, 4551, 4648, 4746, 4847, 4949, 5054, 5160, 5268, 5379, 5491, 5606,
+		 5723, 5842, 5963, 6087, 6213, 6342, 6473, 6606, 6742, 6881, 7022, 7166,
+		 7313, 7462, 7614, 7770, 7928, 8089, 8254, 8421, 8592, 8766, 8943, 9123,
+		 9308, 9495, 9686, 9881,10080,10282,10488,10698,10913,11131,11353,11580,
+		11811,12046,12286,12531,12780,13034,13293,13556,13825,14099,14378,14663,
+		14953,15248,15549,15856,16169,16487,16812,17143,17480,17824,18174,18531,
+		18895,19266,19644,20029,20421,20821,21229,21644,22067,22499,22938,23386,
+		23843,24308,24782,25265,25758,26260,26771,27292,27823,28365,28916,29478,
+		30051,30635,31230,31837,32455,33084,33726,34380,35047,35726,36418,37124,
+		37843,38575,39322,40083,40859,41649,42454,43275,44112,44964,45833,46718,
+		47620,48540,49477,50432,51405,52397,53408,54438,55487,56557,57647,58758,
+		59891,61044,62220,63419,64640,
+	},
+};
@@ -89,9 +89,22 @@ int16_t EEMEM eeRPMMax;
 // max RPM at which the big switch can be thrown
 int16_t EEMEM eeRPMSafe;
 // copy of daily power use
-MEDIAN EEMEM eePowerDays;
+MEDIAN_STORE EEMEM eePowerDays;
 // copy of hourly power use
-MEDIAN EEMEM eePowerHours;
+MEDIAN_STORE EEMEM eePowerHours;
+// shape of the dump load curve
+int16_t EEMEM eeCurve;
+// PI dump load regulator mode, gains and slew limit
+int16_t EEMEM eeRegMode;
+int16_t EEMEM eeKp;
+int16_t EEMEM eeKi;
+int16_t EEMEM eeKd;
+int16_t EEMEM eeSlew;
+// 1-wire devices in the slots they were given when first found, and a CRC of the lot
+OWDEV EEMEM eeOwDev[MAX_OWDEV];
+uint8_t EEMEM eeOwCrc;
+// charge of the battery banks after the first (which is eeCharge)
+int16_t EEMEM eeBankCharge[MAX_BANKS - 1];
 
 void load_eeprom_values(void)
 {
@@ -115,7 +128,14 @@ void load_eeprom_values(void)
 	eeprom_read_block ((void *) &gPoles, (const void *) &eePoles, sizeof (gPoles));
 	eeprom_read_block ((void *) &gUSdate, (const void *) &eeUSdate, sizeof (gUSdate));
 	eeprom_read_block ((void *) &gAdjustTime, (const void *) &eeAdjustTime, sizeof (gAdjustTime));
+	eeprom_read_block ((void *) &gCurve, (const void *) &eeCurve, sizeof (gCurve));
+	eeprom_read_block ((void *) &gRegMode, (const void *) &eeRegMode, sizeof (gRegMode));
+	eeprom_read_block ((void *) &gKp, (const void *) &eeKp, sizeof (gKp));
+	eeprom_read_block ((void *) &gKi, (const void *) &eeKi, sizeof (gKi));
+	eeprom_read_block ((void *) &gKd, (const void *) &eeKd, sizeof (gKd));
+	eeprom_read_block ((void *) &gSlew, (const void *) &eeSlew, sizeof (gSlew));
 
+	update_voffset ();
 }
 
 void save_eeprom_values(void)
@@ -139,5 +159,11 @@ void save_eeprom_values(void)
 	eeprom_write_block ((const void *) &gPoles, (void *) &eePoles, sizeof (gPoles));
 	eeprom_write_block ((const void *) &gUSdate, (void *) &eeUSdate, sizeof (gUSdate));
 	eeprom_write_block ((const void *) &gAdjustTime, (void *) &eeAdjustTime, sizeof (gAdjustTime));
+	eeprom_write_block ((const void *) &gCurve, (void *) &eeCurve, sizeof (gCurve));
+	eeprom_write_block ((const void *) &gRegMode, (void *) &eeRegMode, sizeof (gRegMode));
+	eeprom_write_block ((const void *) &gKp, (void *) &eeKp, sizeof (gKp));
+	eeprom_write_block ((const void *) &gKi, (void *) &eeKi, sizeof (gKi));
+	eeprom_write_block ((const void *) &gKd, (void *) &eeKd, sizeof (gKd));
+	eeprom_write_block ((const void *) &gSlew, (void *) &eeSlew, sizeof (gSlew));
 
 }
\ No newline at end of file
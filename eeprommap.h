@@ -30,6 +30,7 @@
 
 #include "median.h"
 #include "rtc.h"
+#include "measure.h"
 
 
 // configurated max voltage
@@ -85,9 +86,22 @@ extern int16_t EEMEM eeRPMMax;
 extern int16_t EEMEM eeRPMSafe;
 
 // copy of daily power use
-extern MEDIAN EEMEM eePowerDays;
+extern MEDIAN_STORE EEMEM eePowerDays;
 // copy of hourly power use
-extern MEDIAN EEMEM eePowerHours;
+extern MEDIAN_STORE EEMEM eePowerHours;
+// shape of the dump load curve
+extern int16_t EEMEM eeCurve;
+// PI dump load regulator mode, gains and slew limit
+extern int16_t EEMEM eeRegMode;
+extern int16_t EEMEM eeKp;
+extern int16_t EEMEM eeKi;
+extern int16_t EEMEM eeKd;
+extern int16_t EEMEM eeSlew;
+// 1-wire devices in the slots they were given when first found, and a CRC of the lot
+extern OWDEV EEMEM eeOwDev[MAX_OWDEV];
+extern uint8_t EEMEM eeOwCrc;
+// charge of the battery banks after the first (which is eeCharge)
+extern int16_t EEMEM eeBankCharge[MAX_BANKS - 1];
 
 
 void load_eeprom_values(void);
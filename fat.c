@@ -83,6 +83,11 @@
 #define FAT32_CLUSTER_LAST_MIN 0x0ffffff8
 #define FAT32_CLUSTER_LAST_MAX 0x0fffffff
 
+#define FAT_FREE_COUNT_UNKNOWN 0xffffffff
+
+#define FAT_FSINFO_LEAD_SIGNATURE 0x41615252
+#define FAT_FSINFO_STRUCT_SIGNATURE 0x61417272
+
 #define FAT_DIRENTRY_DELETED 0xe5
 #define FAT_DIRENTRY_LFNLAST (1 << 6)
 #define FAT_DIRENTRY_LFNSEQMASK ((1 << 6) - 1)
@@ -151,6 +156,8 @@ struct fat_header_struct
     offset_t root_dir_offset;
 #if FAT_FAT32_SUPPORT
     cluster_t root_dir_cluster;
+    /* 0 if there is no valid FSInfo sector */
+    offset_t fsinfo_offset;
 #endif
 };
 
@@ -159,6 +166,18 @@ struct fat_fs_struct
     struct partition_struct* partition;
     struct fat_header_struct header;
     cluster_t cluster_free;
+    /* FAT_FREE_COUNT_UNKNOWN until read from the FSInfo sector or counted */
+    uint32_t cluster_free_count;
+    /* set when the FSInfo sector no longer matches the two fields above */
+    uint8_t fsinfo_dirty;
+    /* shortest run fat_find_free_run() has failed to find since the mount, 0 if none */
+    cluster_t run_failed;
+};
+
+struct fat_extent_struct
+{
+    cluster_t cluster;
+    cluster_t count;
 };
 
 struct fat_file_struct
@@ -167,6 +186,9 @@ struct fat_file_struct
     struct fat_dir_entry_struct dir_entry;
     offset_t pos;
     cluster_t pos_cluster;
+    /* the first runs of consecutive clusters of the cluster chain */
+    struct fat_extent_struct extents[FAT_FILE_EXTENTS];
+    uint8_t extent_count;
 };
 
 struct fat_dir_struct
@@ -200,8 +222,15 @@ static struct fat_dir_struct fat_dir_handles[FAT_DIR_COUNT];
 #endif
 
 static uint8_t fat_read_header(struct fat_fs_struct* fs);
+#if FAT_FAT32_SUPPORT
+static void fat_read_fsinfo(struct fat_fs_struct* fs);
+#endif
 static cluster_t fat_get_next_cluster(const struct fat_fs_struct* fs, cluster_t cluster_num);
 static offset_t fat_cluster_offset(const struct fat_fs_struct* fs, cluster_t cluster_num);
+static void fat_map_file(struct fat_file_struct* fd);
+static cluster_t fat_extent_skip(const struct fat_file_struct* fd, cluster_t* cluster_num, cluster_t count);
+static cluster_t fat_extent_next(const struct fat_file_struct* fd, cluster_t cluster_num);
+static uint8_t fat_read_data(const struct partition_struct* partition, offset_t offset, uint8_t* buffer, uintptr_t length);
 static uint8_t fat_dir_entry_read_callback(uint8_t* buffer, offset_t offset, void* p);
 #if FAT_LFN_SUPPORT
 static uint8_t fat_calc_83_checksum(const uint8_t* file_name_83);
@@ -213,13 +242,19 @@ static uint8_t fat_get_fs_free_32_callback(uint8_t* buffer, offset_t offset, voi
 #endif
 
 #if FAT_WRITE_SUPPORT
+static void fat_extent_append(struct fat_file_struct* fd, cluster_t cluster_prev, cluster_t cluster_num);
+static void fat_extent_truncate(struct fat_file_struct* fd, cluster_t count);
+static uint8_t fat_write_data(const struct partition_struct* partition, offset_t offset, const uint8_t* buffer, uintptr_t length);
 static cluster_t fat_append_clusters(struct fat_fs_struct* fs, cluster_t cluster_num, cluster_t count);
 static uint8_t fat_free_clusters(struct fat_fs_struct* fs, cluster_t cluster_num);
+static void fat_adjust_free(struct fat_fs_struct* fs, int32_t change);
 static uint8_t fat_terminate_clusters(struct fat_fs_struct* fs, cluster_t cluster_num);
 static uint8_t fat_clear_cluster(const struct fat_fs_struct* fs, cluster_t cluster_num);
 static uintptr_t fat_clear_cluster_callback(uint8_t* buffer, offset_t offset, void* p);
 static offset_t fat_find_offset_for_dir_entry(struct fat_fs_struct* fs, const struct fat_dir_struct* parent, const struct fat_dir_entry_struct* dir_entry);
 static uint8_t fat_write_dir_entry(const struct fat_fs_struct* fs, struct fat_dir_entry_struct* dir_entry);
+static cluster_t fat_find_free_run(struct fat_fs_struct* fs, cluster_t count);
+static uint8_t fat_chain_run(struct fat_fs_struct* fs, cluster_t cluster_num, cluster_t count);
 #if FAT_DATETIME_SUPPORT
 static void fat_set_file_modification_date(struct fat_dir_entry_struct* dir_entry, uint16_t year, uint8_t month, uint8_t day);
 static void fat_set_file_modification_time(struct fat_dir_entry_struct* dir_entry, uint8_t hour, uint8_t min, uint8_t sec);
@@ -267,6 +302,7 @@ struct fat_fs_struct* fat_open(struct partition_struct* partition)
     memset(fs, 0, sizeof(*fs));
 
     fs->partition = partition;
+    fs->cluster_free_count = FAT_FREE_COUNT_UNKNOWN;
     if(!fat_read_header(fs))
     {
 #if USE_DYNAMIC_MEMORY
@@ -276,6 +312,10 @@ struct fat_fs_struct* fat_open(struct partition_struct* partition)
 #endif
         return 0;
     }
+
+#if FAT_FAT32_SUPPORT
+    fat_read_fsinfo(fs);
+#endif
     
     return fs;
 }
@@ -285,7 +325,7 @@ struct fat_fs_struct* fat_open(struct partition_struct* partition)
  * Closes a FAT filesystem.
  *
  * When this function returns, the given filesystem descriptor
- * will be invalid.
+ * will be invalid. The FSInfo sector is brought up to date first.
  *
  * \param[in] fs The filesystem to close.
  * \see fat_open
@@ -295,6 +335,10 @@ void fat_close(struct fat_fs_struct* fs)
     if(!fs)
         return;
 
+#if FAT_WRITE_SUPPORT
+    fat_sync(fs);
+#endif
+
 #if USE_DYNAMIC_MEMORY
     free(fs);
 #else
@@ -320,7 +364,7 @@ uint8_t fat_read_header(struct fat_fs_struct* fs)
 
     /* read fat parameters */
 #if FAT_FAT32_SUPPORT
-    uint8_t buffer[37];
+    uint8_t buffer[39];
 #else
     uint8_t buffer[25];
 #endif
@@ -339,6 +383,7 @@ uint8_t fat_read_header(struct fat_fs_struct* fs)
 #if FAT_FAT32_SUPPORT
     uint32_t sectors_per_fat32 = read32(&buffer[0x19]);
     uint32_t cluster_root_dir = read32(&buffer[0x21]);
+    uint16_t fsinfo_sector = read16(&buffer[0x25]);
 #endif
 
     if(sector_count == 0)
@@ -419,12 +464,54 @@ uint8_t fat_read_header(struct fat_fs_struct* fs)
                                       (offset_t) fat_copies * sectors_per_fat32 * bytes_per_sector;
 
         header->root_dir_cluster = cluster_root_dir;
+
+        if(fsinfo_sector != 0 && fsinfo_sector != 0xffff)
+            header->fsinfo_offset = partition_offset + (offset_t) fsinfo_sector * bytes_per_sector;
     }
 #endif
 
     return 1;
 }
 
+#if DOXYGEN || FAT_FAT32_SUPPORT
+/**
+ * \ingroup fat_fs
+ * Reads the free cluster count and the next free cluster from the FSInfo sector.
+ *
+ * Values which are out of range are ignored. If the sector does not carry
+ * valid signatures, it is neither used nor updated later on.
+ *
+ * \param[in,out] fs The filesystem whose FSInfo sector to read.
+ */
+void fat_read_fsinfo(struct fat_fs_struct* fs)
+{
+    struct fat_header_struct* header = &fs->header;
+    if(!header->fsinfo_offset)
+        return;
+
+    uint8_t buffer[12];
+    if(!fs->partition->device_read(header->fsinfo_offset, buffer, 4) ||
+       read32(buffer) != FAT_FSINFO_LEAD_SIGNATURE ||
+       !fs->partition->device_read(header->fsinfo_offset + 484, buffer, sizeof(buffer)) ||
+       read32(buffer) != FAT_FSINFO_STRUCT_SIGNATURE
+      )
+    {
+        header->fsinfo_offset = 0;
+        return;
+    }
+
+    /* the fat holds two reserved entries in front of the clusters */
+    cluster_t cluster_count = header->fat_size / sizeof(uint32_t);
+    uint32_t free_count = read32(&buffer[4]);
+    uint32_t next_free = read32(&buffer[8]);
+
+    if(free_count <= cluster_count - 2)
+        fs->cluster_free_count = free_count;
+    if(next_free >= 2 && next_free < cluster_count)
+        fs->cluster_free = next_free;
+}
+#endif
+
 /**
  * \ingroup fat_fs
  * Retrieves the next following cluster of a given cluster.
@@ -589,6 +676,7 @@ cluster_t fat_append_clusters(struct fat_fs_struct* fs, cluster_t cluster_num, c
 
         cluster_next = cluster_current;
         --count_left;
+        fat_adjust_free(fs, -1);
     }
 
     do
@@ -632,6 +720,162 @@ cluster_t fat_append_clusters(struct fat_fs_struct* fs, cluster_t cluster_num, c
 }
 #endif
 
+#if FAT_WRITE_SUPPORT
+/**
+ * \ingroup fat_fs
+ * Searches the FAT for a run of consecutive free clusters.
+ *
+ * The FAT is read in small pieces, which the block cache turns into one
+ * card read per sector, starting with the sector of the next free
+ * cluster and giving up after FAT_FREE_RUN_SECTORS sectors.
+ * A failure is remembered until the filesystem is next opened, so a
+ * run at least as long isn't searched for again.
+ *
+ * \param[in] fs The filesystem on which to search.
+ * \param[in] count The number of clusters needed.
+ * \returns The first cluster of the run, or 0 if there is none.
+ */
+cluster_t fat_find_free_run(struct fat_fs_struct* fs, cluster_t count)
+{
+    if(fs->run_failed && count >= fs->run_failed)
+        return 0;
+
+    device_read_t device_read = fs->partition->device_read;
+    offset_t fat_offset = fs->header.fat_offset;
+    uint8_t buffer[64];
+    uint8_t entry_size;
+    cluster_t run_start = 0;
+    cluster_t run_length = 0;
+#if FAT_FAT32_SUPPORT
+    uint8_t is_fat32 = (fs->partition->type == PARTITION_TYPE_FAT32);
+
+    if(is_fat32)
+        entry_size = sizeof(uint32_t);
+    else
+#endif
+        entry_size = sizeof(uint16_t);
+
+    cluster_t cluster_count = fs->header.fat_size / entry_size;
+    uint16_t sector_entries = 512 / entry_size;
+    uint8_t buffer_entries = sizeof(buffer) / entry_size;
+
+    /* start from the beginning of the sector holding the next free cluster */
+    cluster_t cluster_current = fs->cluster_free;
+    if(cluster_current >= cluster_count)
+        cluster_current = 0;
+    cluster_current -= cluster_current % sector_entries;
+
+    for(uint16_t sector = 0; sector < FAT_FREE_RUN_SECTORS; ++sector)
+    {
+        if(cluster_current >= cluster_count)
+        {
+            /* a run can't wrap around the end of the FAT */
+            cluster_current = 0;
+            run_length = 0;
+        }
+
+        for(uint16_t i = 0; i < sector_entries; ++i, ++cluster_current)
+        {
+            uint8_t j = i % buffer_entries;
+            if(j == 0 && !device_read(fat_offset + (offset_t) cluster_current * entry_size, buffer, sizeof(buffer)))
+                return 0;
+
+            uint8_t is_free;
+#if FAT_FAT32_SUPPORT
+            if(is_fat32)
+                is_free = (read32(&buffer[j * 4]) == FAT32_CLUSTER_FREE);
+            else
+#endif
+                is_free = (read16(&buffer[j * 2]) == FAT16_CLUSTER_FREE);
+
+            /* the first two entries aren't clusters */
+            if(!is_free || cluster_current < 2)
+            {
+                run_length = 0;
+                continue;
+            }
+
+            if(run_length++ == 0)
+                run_start = cluster_current;
+            if(run_length >= count)
+                return run_start;
+        }
+    }
+
+    fs->run_failed = count;
+    return 0;
+}
+
+/**
+ * \ingroup fat_fs
+ * Chains a run of consecutive clusters in ascending order.
+ *
+ * The FAT entries are written several at a time rather than one by one.
+ *
+ * \param[in] fs The filesystem on which to operate.
+ * \param[in] cluster_num The first cluster of the run.
+ * \param[in] count The number of clusters in the run.
+ * \returns 0 on failure, 1 on success.
+ */
+uint8_t fat_chain_run(struct fat_fs_struct* fs, cluster_t cluster_num, cluster_t count)
+{
+    device_write_t device_write = fs->partition->device_write;
+    offset_t fat_offset = fs->header.fat_offset;
+    uint8_t buffer[64];
+    uint8_t entry_size;
+#if FAT_FAT32_SUPPORT
+    uint8_t is_fat32 = (fs->partition->type == PARTITION_TYPE_FAT32);
+
+    if(is_fat32)
+        entry_size = sizeof(uint32_t);
+    else
+#endif
+        entry_size = sizeof(uint16_t);
+
+    cluster_t cluster_first = cluster_num;
+    cluster_t cluster_last = cluster_num + count - 1;
+    while(cluster_num <= cluster_last)
+    {
+        offset_t offset = fat_offset + (offset_t) cluster_num * entry_size;
+
+        /* don't let a batch cross a sector, that would cost an extra read */
+        uint8_t batch = (uint8_t) (sizeof(buffer) / entry_size);
+        uint16_t sector_left = (uint16_t) ((512 - (offset & 0x1ff)) / entry_size);
+        if(batch > sector_left)
+            batch = (uint8_t) sector_left;
+        if(batch > cluster_last - cluster_num + 1)
+            batch = (uint8_t) (cluster_last - cluster_num + 1);
+
+        for(uint8_t i = 0; i < batch; ++i)
+        {
+            cluster_t cluster_next = cluster_num + i + 1;
+#if FAT_FAT32_SUPPORT
+            if(is_fat32)
+                write32(&buffer[i * 4], cluster_next > cluster_last ? FAT32_CLUSTER_LAST_MAX : cluster_next);
+            else
+#endif
+                write16(&buffer[i * 2], cluster_next > cluster_last ? FAT16_CLUSTER_LAST_MAX : (uint16_t) cluster_next);
+        }
+
+        if(!device_write(offset, buffer, (uint16_t) batch * entry_size))
+        {
+            /* free what has been chained so far */
+            if(cluster_num > cluster_first)
+            {
+                fat_terminate_clusters(fs, cluster_num - 1);
+                fat_free_clusters(fs, cluster_first);
+            }
+            return 0;
+        }
+
+        cluster_num += batch;
+        fat_adjust_free(fs, -(int32_t) batch);
+    }
+
+    return 1;
+}
+#endif
+
 #if DOXYGEN || FAT_WRITE_SUPPORT
 /**
  * \ingroup fat_fs
@@ -687,7 +931,8 @@ uint8_t fat_free_clusters(struct fat_fs_struct* fs, cluster_t cluster_num)
 
             /* free cluster */
             fat_entry = HTOL32(FAT32_CLUSTER_FREE);
-            fs->partition->device_write(fat_offset + (offset_t) cluster_num * sizeof(fat_entry), (uint8_t*) &fat_entry, sizeof(fat_entry));
+            if(fs->partition->device_write(fat_offset + (offset_t) cluster_num * sizeof(fat_entry), (uint8_t*) &fat_entry, sizeof(fat_entry)))
+                fat_adjust_free(fs, 1);
 
             /* We continue in any case here, even if freeing the cluster failed.
              * The cluster is lost, but maybe we can still free up some later ones.
@@ -721,7 +966,8 @@ uint8_t fat_free_clusters(struct fat_fs_struct* fs, cluster_t cluster_num)
 
             /* free cluster */
             fat_entry = HTOL16(FAT16_CLUSTER_FREE);
-            fs->partition->device_write(fat_offset + (offset_t) cluster_num * sizeof(fat_entry), (uint8_t*) &fat_entry, sizeof(fat_entry));
+            if(fs->partition->device_write(fat_offset + (offset_t) cluster_num * sizeof(fat_entry), (uint8_t*) &fat_entry, sizeof(fat_entry)))
+                fat_adjust_free(fs, 1);
 
             /* We continue in any case here, even if freeing the cluster failed.
              * The cluster is lost, but maybe we can still free up some later ones.
@@ -735,6 +981,57 @@ uint8_t fat_free_clusters(struct fat_fs_struct* fs, cluster_t cluster_num)
 }
 #endif
 
+#if DOXYGEN || FAT_WRITE_SUPPORT
+/**
+ * \ingroup fat_fs
+ * Keeps track of the number of free clusters.
+ *
+ * \param[in] fs The filesystem on which clusters were allocated or freed.
+ * \param[in] change The number of clusters freed, negative for clusters allocated.
+ */
+void fat_adjust_free(struct fat_fs_struct* fs, int32_t change)
+{
+    if(fs->cluster_free_count != FAT_FREE_COUNT_UNKNOWN)
+        fs->cluster_free_count += change;
+    fs->fsinfo_dirty = 1;
+}
+#endif
+
+#if DOXYGEN || FAT_WRITE_SUPPORT
+/**
+ * \ingroup fat_fs
+ * Writes the free cluster count and the next free cluster to the FSInfo sector.
+ *
+ * Only FAT32 filesystems have an FSInfo sector, for FAT16 this does nothing.
+ * The sector is written only if allocations have changed since the last sync.
+ *
+ * \param[in] fs The filesystem to sync.
+ * \returns 0 on failure, 1 on success.
+ * \see fat_sync_file
+ */
+uint8_t fat_sync(struct fat_fs_struct* fs)
+{
+    if(!fs)
+        return 0;
+    if(!fs->fsinfo_dirty)
+        return 1;
+
+#if FAT_FAT32_SUPPORT
+    if(fs->header.fsinfo_offset)
+    {
+        uint8_t buffer[8];
+        write32(&buffer[0], fs->cluster_free_count);
+        write32(&buffer[4], fs->cluster_free >= 2 ? fs->cluster_free : FAT_FREE_COUNT_UNKNOWN);
+        if(!fs->partition->device_write(fs->header.fsinfo_offset + 488, buffer, sizeof(buffer)))
+            return 0;
+    }
+#endif
+
+    fs->fsinfo_dirty = 0;
+    return 1;
+}
+#endif
+
 #if DOXYGEN || FAT_WRITE_SUPPORT
 /**
  * \ingroup fat_fs
@@ -951,6 +1248,7 @@ struct fat_file_struct* fat_open_file(struct fat_fs_struct* fs, const struct fat
     fd->fs = fs;
     fd->pos = 0;
     fd->pos_cluster = dir_entry->cluster;
+    fat_map_file(fd);
 
     return fd;
 }
@@ -979,6 +1277,303 @@ void fat_close_file(struct fat_file_struct* fd)
     }
 }
 
+/**
+ * \ingroup fat_file
+ * Builds the extent list of a file from its cluster chain.
+ *
+ * The chain is followed until it ends or until all extents are used
+ * up, in which case the list covers the start of the chain only.
+ *
+ * \param[in] fd The file handle of the file to map.
+ */
+void fat_map_file(struct fat_file_struct* fd)
+{
+    cluster_t cluster_num = fd->dir_entry.cluster;
+    struct fat_extent_struct* extent = fd->extents;
+
+    fd->extent_count = 0;
+    if(!cluster_num)
+        return;
+
+    extent->cluster = cluster_num;
+    extent->count = 1;
+    fd->extent_count = 1;
+
+    while((cluster_num = fat_get_next_cluster(fd->fs, cluster_num)))
+    {
+        if(cluster_num == extent->cluster + extent->count)
+        {
+            ++extent->count;
+            continue;
+        }
+
+        if(fd->extent_count >= FAT_FILE_EXTENTS)
+            break;
+
+        ++extent;
+        extent->cluster = cluster_num;
+        extent->count = 1;
+        ++fd->extent_count;
+    }
+}
+
+/**
+ * \ingroup fat_file
+ * Moves along the cluster chain of a file as far as its extent list allows.
+ *
+ * \param[in] fd The file handle of the file.
+ * \param[out] cluster_num The cluster reached.
+ * \param[in] count The number of clusters to move on from the first one.
+ * \returns The number of clusters moved on, which is less than \c count if the extents end before.
+ */
+cluster_t fat_extent_skip(const struct fat_file_struct* fd, cluster_t* cluster_num, cluster_t count)
+{
+    const struct fat_extent_struct* extent = fd->extents;
+    cluster_t skipped = 0;
+
+    for(uint8_t i = 0; i < fd->extent_count; ++i, ++extent)
+    {
+        if(count - skipped < extent->count)
+        {
+            *cluster_num = extent->cluster + (count - skipped);
+            return count;
+        }
+        skipped += extent->count;
+    }
+
+    if(!skipped)
+        return 0;
+
+    /* stop at the last cluster known */
+    --extent;
+    *cluster_num = extent->cluster + extent->count - 1;
+    return skipped - 1;
+}
+
+/**
+ * \ingroup fat_file
+ * Retrieves the cluster following the given one in the chain of a file.
+ *
+ * The FAT is only read if the cluster is the last one of the extent list.
+ *
+ * \param[in] fd The file handle of the file.
+ * \param[in] cluster_num The cluster of the file whose successor to find.
+ * \returns The next cluster, or 0 at the end of the chain or on failure.
+ */
+cluster_t fat_extent_next(const struct fat_file_struct* fd, cluster_t cluster_num)
+{
+    const struct fat_extent_struct* extent = fd->extents;
+    for(uint8_t i = 0; i < fd->extent_count; ++i, ++extent)
+    {
+        if(cluster_num < extent->cluster || cluster_num >= extent->cluster + extent->count)
+            continue;
+
+        if(cluster_num + 1 < extent->cluster + extent->count)
+            return cluster_num + 1;
+        if(i + 1 < fd->extent_count)
+            return extent[1].cluster;
+        break;
+    }
+
+    return fat_get_next_cluster(fd->fs, cluster_num);
+}
+
+#if DOXYGEN || FAT_WRITE_SUPPORT
+/**
+ * \ingroup fat_file
+ * Records a cluster which has just been appended to the chain of a file.
+ *
+ * \param[in] fd The file handle of the file.
+ * \param[in] cluster_prev The cluster the new one was appended to, 0 if the file was empty.
+ * \param[in] cluster_num The new cluster.
+ */
+void fat_extent_append(struct fat_file_struct* fd, cluster_t cluster_prev, cluster_t cluster_num)
+{
+    if(!fd->extent_count)
+    {
+        if(cluster_prev)
+            return;
+
+        fd->extents[0].cluster = cluster_num;
+        fd->extents[0].count = 1;
+        fd->extent_count = 1;
+        return;
+    }
+
+    /* the list only ever covers the start of the chain */
+    struct fat_extent_struct* extent = &fd->extents[fd->extent_count - 1];
+    if(cluster_prev != extent->cluster + extent->count - 1)
+        return;
+
+    if(cluster_num == cluster_prev + 1)
+    {
+        ++extent->count;
+    }
+    else if(fd->extent_count < FAT_FILE_EXTENTS)
+    {
+        ++extent;
+        extent->cluster = cluster_num;
+        extent->count = 1;
+        ++fd->extent_count;
+    }
+}
+
+/**
+ * \ingroup fat_file
+ * Shortens the extent list of a file whose cluster chain was cut.
+ *
+ * \param[in] fd The file handle of the file.
+ * \param[in] count The number of clusters left in the chain.
+ */
+void fat_extent_truncate(struct fat_file_struct* fd, cluster_t count)
+{
+    struct fat_extent_struct* extent = fd->extents;
+    for(uint8_t i = 0; i < fd->extent_count; ++i, ++extent)
+    {
+        if(count <= extent->count)
+        {
+            extent->count = count;
+            fd->extent_count = count ? i + 1 : i;
+            return;
+        }
+        count -= extent->count;
+    }
+}
+#endif
+
+#if DOXYGEN || FAT_WRITE_SUPPORT
+/**
+ * \ingroup fat_file
+ * Writes the directory entry of an open file to disk.
+ *
+ * With FAT_DELAY_DIRENTRY_UPDATE enabled, the size of a file which
+ * grows is only recorded on disk when the file is closed. Calling
+ * this function brings the directory entry up to date while keeping
+ * the file open, e.g. after appending a record to a log file.
+ *
+ * Only the cluster, time, date and size fields of the 8.3 entry are
+ * written, the name and any lfn entries are left alone.
+ *
+ * The FSInfo sector of the filesystem is synced as well, see fat_sync().
+ *
+ * \param[in] fd The file handle of the file to synchronize.
+ * \returns 0 on failure, 1 on success.
+ * \see fat_close_file, fat_write_file
+ */
+uint8_t fat_sync_file(struct fat_file_struct* fd)
+{
+    if(!fd)
+        return 0;
+
+#if FAT_DELAY_DIRENTRY_UPDATE
+    struct fat_dir_entry_struct* dir_entry = &fd->dir_entry;
+#if FAT_DATETIME_SUPPORT
+    {
+        uint16_t year;
+        uint8_t month;
+        uint8_t day;
+        uint8_t hour;
+        uint8_t min;
+        uint8_t sec;
+
+        fat_get_datetime(&year, &month, &day, &hour, &min, &sec);
+        fat_set_file_modification_date(dir_entry, year, month, day);
+        fat_set_file_modification_time(dir_entry, hour, min, sec);
+    }
+#endif
+
+    /* skip the lfn entries, see fat_write_dir_entry() */
+    offset_t offset = dir_entry->entry_offset;
+#if FAT_LFN_SUPPORT
+    offset += (uint16_t) ((strlen(dir_entry->long_name) + 12) / 13) * 32;
+#endif
+
+    /* fields 0x14 to 0x1f of the 8.3 entry */
+    uint8_t buffer[12];
+    memset(buffer, 0, sizeof(buffer));
+#if FAT_FAT32_SUPPORT
+    write16(&buffer[0x00], (uint16_t) (dir_entry->cluster >> 16));
+#endif
+#if FAT_DATETIME_SUPPORT
+    write16(&buffer[0x02], dir_entry->modification_time);
+    write16(&buffer[0x04], dir_entry->modification_date);
+#endif
+    write16(&buffer[0x06], dir_entry->cluster);
+    write32(&buffer[0x08], dir_entry->file_size);
+
+    if(!fd->fs->partition->device_write(offset + 0x14, buffer, sizeof(buffer)))
+        return 0;
+#endif
+
+    return fat_sync(fd->fs);
+}
+#endif
+
+/**
+ * \ingroup fat_file
+ * Reads file data from the device.
+ *
+ * Whole blocks are handed to the device's block read if it has one,
+ * which can skip the block cache and read several in one transfer.
+ * Whatever is left over goes through the ordinary read.
+ *
+ * \param[in] partition The partition from which to read.
+ * \param[in] offset The offset on the device where to start reading.
+ * \param[out] buffer The buffer into which to place the data.
+ * \param[in] length The count of bytes to read.
+ * \returns 0 on failure, 1 on success.
+ */
+uint8_t fat_read_data(const struct partition_struct* partition, offset_t offset, uint8_t* buffer, uintptr_t length)
+{
+    uint16_t count = length / 512;
+    if(partition->device_read_blocks && !(offset & 0x01ff) && count > 0)
+    {
+        if(!partition->device_read_blocks(offset, buffer, count))
+            return 0;
+
+        offset += (offset_t) count * 512;
+        buffer += (uintptr_t) count * 512;
+        length -= (uintptr_t) count * 512;
+        if(!length)
+            return 1;
+    }
+
+    return partition->device_read(offset, buffer, length);
+}
+
+#if DOXYGEN || FAT_WRITE_SUPPORT
+/**
+ * \ingroup fat_file
+ * Writes file data to the device.
+ *
+ * Whole blocks are handed to the device's multiple block write if it
+ * has one, whatever is left over goes through the ordinary write.
+ *
+ * \param[in] partition The partition to which to write.
+ * \param[in] offset The offset on the device where to start writing.
+ * \param[in] buffer The buffer which to write.
+ * \param[in] length The count of bytes to write.
+ * \returns 0 on failure, 1 on success.
+ */
+uint8_t fat_write_data(const struct partition_struct* partition, offset_t offset, const uint8_t* buffer, uintptr_t length)
+{
+    uint16_t count = length / 512;
+    if(partition->device_write_blocks && !(offset & 0x01ff) && count > 1)
+    {
+        if(!partition->device_write_blocks(offset, buffer, count))
+            return 0;
+
+        offset += (offset_t) count * 512;
+        buffer += (uintptr_t) count * 512;
+        length -= (uintptr_t) count * 512;
+        if(!length)
+            return 1;
+    }
+
+    return partition->device_write(offset, buffer, length);
+}
+#endif
+
 /**
  * \ingroup fat_file
  * Reads data from a file.
@@ -1024,6 +1619,10 @@ intptr_t fat_read_file(struct fat_file_struct* fd, uint8_t* buffer, uintptr_t bu
         if(fd->pos)
         {
             uint32_t pos = fd->pos;
+
+            /* within the extents the cluster can be worked out directly */
+            pos -= (uint32_t) fat_extent_skip(fd, &cluster_num, pos / cluster_size) * cluster_size;
+
             while(pos >= cluster_size)
             {
                 pos -= cluster_size;
@@ -1044,7 +1643,7 @@ intptr_t fat_read_file(struct fat_file_struct* fd, uint8_t* buffer, uintptr_t bu
             copy_length = buffer_left;
 
         /* read data */
-        if(!fd->fs->partition->device_read(cluster_offset, buffer, copy_length))
+        if(!fat_read_data(fd->fs->partition, cluster_offset, buffer, copy_length))
             return buffer_len - buffer_left;
 
         /* calculate new file position */
@@ -1055,7 +1654,9 @@ intptr_t fat_read_file(struct fat_file_struct* fd, uint8_t* buffer, uintptr_t bu
         if(first_cluster_offset + copy_length >= cluster_size)
         {
             /* we are on a cluster boundary, so get the next cluster */
-            if((cluster_num = fat_get_next_cluster(fd->fs, cluster_num)))
+            cluster_num = fat_extent_next(fd, cluster_num);
+
+            if(cluster_num)
             {
                 first_cluster_offset = 0;
             }
@@ -1112,6 +1713,7 @@ intptr_t fat_write_file(struct fat_file_struct* fd, const uint8_t* buffer, uintp
                 fd->dir_entry.cluster = cluster_num = fat_append_clusters(fd->fs, 0, 1);
                 if(!cluster_num)
                     return 0;
+                fat_extent_append(fd, 0, cluster_num);
             }
             else
             {
@@ -1123,6 +1725,10 @@ intptr_t fat_write_file(struct fat_file_struct* fd, const uint8_t* buffer, uintp
         {
             uint32_t pos = fd->pos;
             cluster_t cluster_num_next;
+
+            /* within the extents the cluster can be worked out directly */
+            pos -= (uint32_t) fat_extent_skip(fd, &cluster_num, pos / cluster_size) * cluster_size;
+
             while(pos >= cluster_size)
             {
                 pos -= cluster_size;
@@ -1136,6 +1742,7 @@ intptr_t fat_write_file(struct fat_file_struct* fd, const uint8_t* buffer, uintp
                     cluster_num_next = fat_append_clusters(fd->fs, cluster_num, 1);
                     if(!cluster_num_next)
                         return 0;
+                    fat_extent_append(fd, cluster_num, cluster_num_next);
                 }
 
                 cluster_num = cluster_num_next;
@@ -1153,7 +1760,7 @@ intptr_t fat_write_file(struct fat_file_struct* fd, const uint8_t* buffer, uintp
             write_length = buffer_left;
 
         /* write data which fits into the current cluster */
-        if(!fd->fs->partition->device_write(cluster_offset, buffer, write_length))
+        if(!fat_write_data(fd->fs->partition, cluster_offset, buffer, write_length))
             break;
 
         /* calculate new file position */
@@ -1164,10 +1771,14 @@ intptr_t fat_write_file(struct fat_file_struct* fd, const uint8_t* buffer, uintp
         if(first_cluster_offset + write_length >= cluster_size)
         {
             /* we are on a cluster boundary, so get the next cluster */
-            cluster_t cluster_num_next = fat_get_next_cluster(fd->fs, cluster_num);
+            cluster_t cluster_num_next = fat_extent_next(fd, cluster_num);
             if(!cluster_num_next && buffer_left > 0)
+            {
                 /* we reached the last cluster, append a new one */
                 cluster_num_next = fat_append_clusters(fd->fs, cluster_num, 1);
+                if(cluster_num_next)
+                    fat_extent_append(fd, cluster_num, cluster_num_next);
+            }
             if(!cluster_num_next)
             {
                 fd->pos_cluster = 0;
@@ -1347,6 +1958,9 @@ uint8_t fat_resize_file(struct fat_file_struct* fd, uint32_t size)
                 cluster_num = cluster_new_chain;
                 fd->dir_entry.cluster = cluster_num;
             }
+
+            /* the new clusters are not chained in order, map them afresh */
+            fat_map_file(fd);
         }
 
         /* write new directory entry */
@@ -1360,11 +1974,15 @@ uint8_t fat_resize_file(struct fat_file_struct* fd, uint32_t size)
         {
             /* free all clusters of file */
             fat_free_clusters(fd->fs, cluster_num);
+            fd->extent_count = 0;
         }
         else if(size_new <= cluster_size)
         {
             /* free all clusters no longer needed */
             fat_terminate_clusters(fd->fs, cluster_num);
+
+            /* the extents can't go beyond the end of the chain */
+            fat_extent_truncate(fd, (size + cluster_size - 1) / cluster_size);
         }
 
     } while(0);
@@ -1380,6 +1998,65 @@ uint8_t fat_resize_file(struct fat_file_struct* fd, uint32_t size)
 }
 #endif
 
+#if DOXYGEN || FAT_WRITE_SUPPORT
+/**
+ * \ingroup fat_file
+ * Preallocates a contiguous run of clusters for an empty file.
+ *
+ * The clusters are chained to the file in ascending order, but the
+ * file size stays zero. The space beyond the end of the file remains
+ * allocated until the file is truncated to its real length with
+ * fat_resize_file(). The whole run makes up a single extent, so reads
+ * and writes anywhere within it work out the cluster directly instead
+ * of following the cluster chain.
+ *
+ * Only the part of the FAT near the next free cluster is searched, see
+ * fat_find_free_run(). If there's no run there the file is left empty
+ * and grows through fat_append_clusters() as it is written, as any
+ * other file does.
+ *
+ * \param[in] fd The file handle of the empty file.
+ * \param[in] size The number of bytes to reserve space for.
+ * \returns 0 on failure or if no contiguous run of free clusters is big enough, 1 on success.
+ * \see fat_resize_file
+ */
+uint8_t fat_preallocate_file(struct fat_file_struct* fd, uint32_t size)
+{
+    if(!fd || size == 0 || fd->dir_entry.cluster || fd->dir_entry.file_size)
+        return 0;
+
+    struct fat_fs_struct* fs = fd->fs;
+    uint16_t cluster_size = fs->header.cluster_size;
+    cluster_t count = (size + cluster_size - 1) / cluster_size;
+
+    cluster_t cluster_num = fat_find_free_run(fs, count);
+    if(!cluster_num)
+        return 0;
+
+    if(!fat_chain_run(fs, cluster_num, count))
+        return 0;
+
+    /* record the chain in the directory entry straight away so it can't get lost */
+    fd->dir_entry.cluster = cluster_num;
+    if(!fat_write_dir_entry(fs, &fd->dir_entry))
+    {
+        fat_free_clusters(fs, cluster_num);
+        fd->dir_entry.cluster = 0;
+        return 0;
+    }
+
+    fd->pos_cluster = 0;
+    fd->extents[0].cluster = cluster_num;
+    fd->extents[0].count = count;
+    fd->extent_count = 1;
+
+    /* the run is used up, start looking for free clusters after it next time */
+    fs->cluster_free = cluster_num + count;
+
+    return 1;
+}
+#endif
+
 /**
  * \ingroup fat_dir
  * Opens a directory.
@@ -2467,14 +3144,20 @@ offset_t fat_get_fs_size(const struct fat_fs_struct* fs)
  * \note As the FAT filesystem is cluster based, this function does not
  *       return continuous values but multiples of the cluster size.
  *
+ * The FAT is only scanned if the free cluster count is not known yet,
+ * either from the FSInfo sector of a FAT32 or from an earlier call.
+ *
  * \param[in] fs The filesystem on which to operate.
  * \returns 0 on failure, the free filesystem space in bytes otherwise.
  */
-offset_t fat_get_fs_free(const struct fat_fs_struct* fs)
+offset_t fat_get_fs_free(struct fat_fs_struct* fs)
 {
     if(!fs)
         return 0;
 
+    if(fs->cluster_free_count != FAT_FREE_COUNT_UNKNOWN)
+        return (offset_t) fs->cluster_free_count * fs->header.cluster_size;
+
     uint8_t fat[32];
     struct fat_usage_count_callback_arg count_arg;
     count_arg.cluster_count = 0;
@@ -2508,6 +3191,10 @@ offset_t fat_get_fs_free(const struct fat_fs_struct* fs)
         fat_size -= length;
     }
 
+    /* from now on the count is kept up to date as clusters come and go */
+    fs->cluster_free_count = count_arg.cluster_count;
+    fs->fsinfo_dirty = 1;
+
     return (offset_t) count_arg.cluster_count * fs->header.cluster_size;
 }
 
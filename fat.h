@@ -91,6 +91,7 @@ struct fat_dir_entry_struct
 
 struct fat_fs_struct* fat_open(struct partition_struct* partition);
 void fat_close(struct fat_fs_struct* fs);
+uint8_t fat_sync(struct fat_fs_struct* fs);
 
 struct fat_file_struct* fat_open_file(struct fat_fs_struct* fs, const struct fat_dir_entry_struct* dir_entry);
 void fat_close_file(struct fat_file_struct* fd);
@@ -98,6 +99,8 @@ intptr_t fat_read_file(struct fat_file_struct* fd, uint8_t* buffer, uintptr_t bu
 intptr_t fat_write_file(struct fat_file_struct* fd, const uint8_t* buffer, uintptr_t buffer_len);
 uint8_t fat_seek_file(struct fat_file_struct* fd, int32_t* offset, uint8_t whence);
 uint8_t fat_resize_file(struct fat_file_struct* fd, uint32_t size);
+uint8_t fat_sync_file(struct fat_file_struct* fd);
+uint8_t fat_preallocate_file(struct fat_file_struct* fd, uint32_t size);
 
 struct fat_dir_struct* fat_open_dir(struct fat_fs_struct* fs, const struct fat_dir_entry_struct* dir_entry);
 void fat_close_dir(struct fat_dir_struct* dd);
@@ -117,7 +120,7 @@ void fat_get_file_modification_time(const struct fat_dir_entry_struct* dir_entry
 uint8_t fat_get_dir_entry_of_path(struct fat_fs_struct* fs, const char* path, struct fat_dir_entry_struct* dir_entry);
 
 offset_t fat_get_fs_size(const struct fat_fs_struct* fs);
-offset_t fat_get_fs_free(const struct fat_fs_struct* fs);
+offset_t fat_get_fs_free(struct fat_fs_struct* fs);
 
 /**
  * @}
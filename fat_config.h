@@ -101,8 +101,31 @@ void get_datetime(uint16_t* year, uint8_t* month, uint8_t* day, uint8_t* hour, u
 /**
  * \ingroup fat_config
  * Maximum number of file handles.
+ *
+ * The logger keeps the day's log file open, so a second handle is
+ * needed to read a file at the same time.
+ */
+#define FAT_FILE_COUNT 2
+
+/**
+ * \ingroup fat_config
+ * Number of extents remembered per open file.
+ *
+ * Each extent is a run of consecutive clusters of the file's cluster
+ * chain. Positions within the extents are found without reading the
+ * FAT, beyond them the chain is followed as usual.
+ */
+#define FAT_FILE_EXTENTS 4
+
+/**
+ * \ingroup fat_config
+ * Number of FAT sectors searched for a run of free clusters.
+ *
+ * Preallocating a file looks this far on from the next free cluster,
+ * which covers 4096 clusters on FAT16 and 2048 on FAT32, before it
+ * gives up and leaves the file to grow a cluster at a time.
  */
-#define FAT_FILE_COUNT 1
+#define FAT_FREE_RUN_SECTORS 16
 
 /**
  * \ingroup fat_config
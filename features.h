@@ -7,6 +7,17 @@
 // debugging uses the serial port rather than a pushbutton array
 #define PUSHBUTTONS 1
 
+// log records that can be waiting to be written to the SD card (32 bytes each)
+#define LOG_QUEUE_SIZE 8
+// log records written to the SD card per pass of the main loop
+#define LOG_DRAIN_PER_PASS 1
+// longest time in seconds log data is held in RAM before being written to the SD card (as a partial sector)
+#define LOG_FLUSH_AGE 600
+// log records expected per day (minute marks plus events), used to preallocate each day's log file
+#define LOG_RECORDS_PER_DAY 1700
+// log to the SD card as 32 byte binary records in log-YYMMDD.bin rather than text lines in log-YYMMDD.txt
+#define LOG_BINARY 0
+
 // defaults defined by the code used when <right> is pressed during field edit
 
 #define ddVlower         2200         // volt limit low
@@ -30,6 +41,12 @@
 #define ddLoad              0         // manual on/off
 #define ddRPMMax          300         // max RPM before shutdown
 #define ddRPMSafe         180         // max RPM at which the big switch can be thrown
+#define ddCurve             2         // dump load curve, 0-3 for shapes 15, 31, 63 and 127
+#define ddRegMode           0         // dump load regulator, 0 = curve, 1 = PI
+#define ddKp              200         // PI proportional gain, PWM counts per volt
+#define ddKi              100         // PI integral gain, PWM counts per volt-second
+#define ddKd                0         // PI derivative gain, PWM counts per volt/second
+#define ddSlew            500         // PI slew limit, PWM counts per second
 
 #define ddShunt          1000         // shunt conductance in Siemens
 #define ddPoles             6         // magnetic poles in generator
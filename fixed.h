@@ -0,0 +1,122 @@
+//---------------------------------------------------------------------------
+// Copyright (C) 2012 Robin Gilks
+//
+//
+//  fixed.h   -   Fixed point (Q format) arithmetic so the main loop can stay clear of the soft-float library
+//
+//  History:   1.0 - First release. 
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+// 
+
+
+#ifndef _FIXED_H
+#define _FIXED_H
+
+
+#include <stdint.h>
+
+// Scale factors are held as Q2.14: a 16 bit signed number with 14 bits after the binary point, good for
+// -2.0 to just under 2.0 to about 4 decimal places. That covers all the percentages and calibration
+// factors we use, and a 16x16 bit multiply into 32 bits is all the AVR needs to apply one.
+//
+// Anything turning an int16_t into a scaled int16_t truncates towards zero and saturates, which is
+// what assigning the float result to an int16_t used to do (apart from the saturation).
+
+#define FIX_FRAC 14
+#define FIX_ONE (1 << FIX_FRAC)
+
+typedef int16_t fix_t;
+
+// make a fix_t out of a constant, rounded to nearest. Only use this on constants so the compiler
+// does the float arithmetic, not the AVR.
+#define FIX(x) ((fix_t) ((x) * FIX_ONE + ((x) < 0 ? -0.5 : 0.5)))
+
+// clamp a 32 bit intermediate to what fits in 16 bits
+static inline int16_t
+fix_sat16 (int32_t v)
+{
+	if (v > INT16_MAX)
+		return INT16_MAX;
+	if (v < INT16_MIN)
+		return INT16_MIN;
+	return (int16_t) v;
+}
+
+// a float setting as a fix_t, rounded to nearest and saturated. This pulls in the float library so it's
+// for when a setting changes, not for every time round the loop.
+static inline fix_t
+fix_from_float (float x)
+{
+	if (x >= 2.0)
+		return INT16_MAX;
+	if (x <= -2.0)
+		return INT16_MIN;
+	return fix_sat16 ((int32_t) (x * FIX_ONE + (x < 0 ? -0.5 : 0.5)));
+}
+
+static inline int16_t
+fix_add_sat (int16_t a, int16_t b)
+{
+	return fix_sat16 ((int32_t) a + b);
+}
+
+static inline int16_t
+fix_sub_sat (int16_t a, int16_t b)
+{
+	return fix_sat16 ((int32_t) a - b);
+}
+
+// drop the fraction bits of a product, rounding towards zero like a float to int conversion does
+static inline int32_t
+fix_trunc (int32_t v)
+{
+	if (v < 0)
+		return -((-v) >> FIX_FRAC);
+	return v >> FIX_FRAC;
+}
+
+// v * k
+static inline int16_t
+fix_scale (int16_t v, fix_t k)
+{
+	return fix_sat16 (fix_trunc ((int32_t) v * k));
+}
+
+// a * b of two scale factors
+static inline fix_t
+fix_mul (fix_t a, fix_t b)
+{
+	return fix_sat16 (fix_trunc ((int32_t) a * b));
+}
+
+// num / den as a scale factor, saturated to the fix_t range
+static inline fix_t
+fix_div (int16_t num, int16_t den)
+{
+	if (den == 0)
+		return (num < 0) ? INT16_MIN : INT16_MAX;
+	return fix_sat16 (((int32_t) num << FIX_FRAC) / den);
+}
+
+// a * b / c with a 32 bit intermediate, for multiplying two scaled values and taking the scaling back out
+static inline int16_t
+fix_muldiv (int16_t a, int16_t b, int16_t c)
+{
+	if (c == 0)
+		return 0;
+	return fix_sat16 ((int32_t) a * b / c);
+}
+
+#endif
@@ -40,6 +40,7 @@
 
 #include "features.h"
 #include "median.h"
+#include "rollup.h"
 #include "graph.h"
 #include "rtc.h"
 #include "eeprommap.h"
@@ -48,6 +49,8 @@
 
 
 MEDIAN PowerMins;
+// power rolled up by second, minute, hour, day and month
+ROLLUP PowerRollup;
 MEDIAN PowerHours;
 MEDIAN PowerDays;
 
@@ -72,26 +75,32 @@ graph_init (void)
 	uint8_t i;
 
 	// read old days info from eeprom and if it look wrong, initialise it to zero
-	eeprom_read_block ((void *) &PowerDays, (const void *) &eePowerDays, sizeof (PowerDays));
+	eeprom_read_block ((void *) &PowerDays.s, (const void *) &eePowerDays, sizeof (PowerDays.s));
 	if (median_getSize(&PowerDays) != 20)
 	{
 		median_init(&PowerDays, 20);
 		for (i = 0; i < 20; i++)
 			median_add(&PowerDays, 0);
 
-		eeprom_write_block ((const void *) &PowerDays, (void *) &eePowerDays, sizeof (PowerDays));
+		eeprom_write_block ((const void *) &PowerDays.s, (void *) &eePowerDays, sizeof (PowerDays.s));
 	}
+	else
+		median_rebuild(&PowerDays);
 
 	// do the same with hours
-	eeprom_read_block ((void *) &PowerHours, (const void *) &eePowerHours, sizeof (PowerHours));
+	eeprom_read_block ((void *) &PowerHours.s, (const void *) &eePowerHours, sizeof (PowerHours.s));
 	if (median_getSize(&PowerHours) != 20)
 	{
 		median_init(&PowerHours, 20);
 		for (i = 0; i < 20; i++)
 			median_add(&PowerHours, 0);
 
-		eeprom_write_block ((const void *) &PowerHours, (void *) &eePowerHours, sizeof (PowerHours));
+		eeprom_write_block ((const void *) &PowerHours.s, (void *) &eePowerHours, sizeof (PowerHours.s));
 	}
+	else
+		median_rebuild(&PowerHours);
+
+	rollup_register(&PowerRollup);
 
 	median_init(&PowerMins, 20);
 	for (i = 0; i < 20; i++)
@@ -112,49 +121,34 @@ graph_init (void)
 void
 run_graph (void)
 {
-	static uint32_t lastsec = 0, lastmin = 0, lasthour = 0, lastday = 0;
-	static int32_t pLastMin = 0, pLastHour = 0, pLastDay = 0;
 	static uint8_t mincount = 0;
 
+	// power goes into the rollup every time round, it works out the averages for each minute, hour and day
+	rollup_add(&PowerRollup, gPower);
 
-	// see if a second has passed, if so add power into minute accumulator
-	if (uptime() >= lastsec + 1)
-	{
-		pLastMin += gPower;
-		lastsec = uptime();
-	}
-
-	// see if a minute has passed, if so advance the pointer to track the last 60 minutes
-	if (uptime() >= lastmin + 60)
+	// see if a minute has passed, if so add its average power to the graph every third one
+	if (rollup_ticks() & ROLLUP_TICK(ROLLUP_MINUTE))
 	{
-		pLastHour += pLastMin / 60;
 		if (++mincount >= 3)
 		{
-			median_add(&PowerMins, (int16_t)(pLastMin / 60));
+			median_add(&PowerMins, rollup_mean(rollup_last(&PowerRollup, ROLLUP_MINUTE)));
 			mincount = 0;
 		}
-		pLastMin = 0;
-		lastmin = uptime();
 	}
 
 	// see if an hour has passed, if so advance the pointer to track the last 20 of them
-	if (uptime() >= lasthour + 3600)
+	if (rollup_ticks() & ROLLUP_TICK(ROLLUP_HOUR))
 	{
-		pLastDay += pLastHour / 60;
-		median_add(&PowerHours, (int16_t)(pLastHour / 60));
-		eeprom_write_block ((const void *) &PowerHours, (void *) &eePowerHours, sizeof (PowerHours));
-		pLastHour = 0;
-		lasthour = uptime();
+		median_add(&PowerHours, rollup_mean(rollup_last(&PowerRollup, ROLLUP_HOUR)));
+		eeprom_write_block ((const void *) &PowerHours.s, (void *) &eePowerHours, sizeof (PowerHours.s));
 	}
 
 	// see if a day has passed, if so advance the pointer to track the last 20 days
-	if (uptime() >= lastday + 86400)
+	if (rollup_ticks() & ROLLUP_TICK(ROLLUP_DAY))
 	{
-		// track daily totals in watt-hours
-		median_add(&PowerDays, (int16_t)pLastDay);
-		eeprom_write_block ((const void *) &PowerDays, (void *) &eePowerDays, sizeof (PowerDays));
-		pLastDay = 0;
-		lastday = uptime();
+		// track daily totals in watt-hours, the sum of the hourly averages
+		median_add(&PowerDays, (int16_t)rollup_last(&PowerRollup, ROLLUP_DAY)->sum);
+		eeprom_write_block ((const void *) &PowerDays.s, (void *) &eePowerDays, sizeof (PowerDays.s));
 	}
 }
 
@@ -22,6 +22,7 @@
 #ifndef _GRAPH_H
 #define _GRAPH_H
 
+#include "rollup.h"
 
 #define MINGRAPH  0
 #define HOURGRAPH 1
@@ -41,6 +42,8 @@
 #define TOPQUAR 7
 #define DEGREE  0xdf
 
+extern ROLLUP PowerRollup;
+
 void graph_init (void);
 void run_graph (void);
 void print_graph (KFile *stream, uint8_t type, uint8_t style);
@@ -40,6 +40,7 @@
 #include "tlog.h"
 #include "rpm.h"
 #include "rtc.h"
+#include "rollup.h"
 #include "graph.h"
 #include "ui.h"
 
@@ -93,6 +94,8 @@ int main(void)
 	{
 		// keep the clock ticking
 		run_rtc();
+		// work out which minutes, hours and days have just finished for everything else
+		run_rollup();
       // run volts/amps/temperature reading stuff on the onewire interface
       run_measure();
       // decide if inverter or shunt load is needed to be turned on
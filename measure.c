@@ -32,6 +32,7 @@
 
 #include <drv/timer.h>
 #include <drv/ser.h>
+#include <drv/ow_1wire.h>
 #include <drv/ow_ds2438.h>
 #include <drv/ow_ds2413.h>
 #include <drv/ow_ds18x20.h>
@@ -44,7 +45,10 @@
 #include "control.h"
 #include "median.h"
 #include "minmax.h"
+#include "rollup.h"
+#include "fixed.h"
 #include "eeprommap.h"
+#include "owdev.h"
 #include "measure.h"
 
 extern Serial serial;
@@ -57,12 +61,55 @@ extern Serial serial;
 // in this case 7 days
 #define SELFDISCHARGE 604800L
 
-MEDIAN AmpsMedian;
-MEDIAN VoltsMedian;
-MEDIAN TempMedian;
+// DS2438 conversions are started here and collected on a later pass rather than with
+// ow_ds2438_doconvert, which holds the whole loop up until they're done
+#define DS2438_CONVERT_T      0x44
+#define DS2438_CONVERT_V      0xb4
+#define DS2438_CONVERT_TIME   10L     // mS, worst case for either conversion
+#define DS2438_READ_TRIES     3       // goes at reading the results before starting again
+#define BANK_PERIOD           50L     // mS between readings of each battery monitor
+
+// the external thermometer is read at full resolution, which takes up to 750mS a conversion. The
+// same applies to a DS18S20 which is fixed at 9 bits
+#define DS18X20_RESOLUTION    12
+#define DS18X20_CONVERT_TIME  750L    // mS
+#define THERM_PERIOD          60000L  // mS between readings of each thermometer
+
+enum AcquireStates
+{
+	ACQ_START,
+	ACQ_TEMP,
+	ACQ_VOLTS
+};
+
+// a battery monitor, its readings and where it's got to in a conversion
+typedef struct bank
+{
+	int8_t dev;                   // slot in owdev[], -1 if none
+	CTX2438_t Result;
+	MEDIAN Amps;
+	MEDIAN Volts;
+	uint8_t state;
+	uint8_t tries;
+	ticks_t started;
+	bool fresh;                   // new readings since run_measure last looked
+} BANK;
+
+// an external thermometer
+typedef struct therm
+{
+	int8_t dev;                   // slot in owdev[], -1 if none
+	MEDIAN Temp;
+	bool converting;
+	ticks_t started;
+} THERM;
+
+// the first of each is the one the controller runs from
+BANK banks[MAX_BANKS];
+THERM therms[MAX_THERMS];
+MEDIAN TempMedian;			  // DS2438 temperature for when there's no external thermometer
 
-MINMAX hourmax, daymax;
-MINMAX hourmin, daymin;
+MINMAX2 hourminmax, dayminmax;
 
 int16_t gVolts;
 int16_t iVolts;
@@ -71,6 +118,7 @@ int16_t gPower;
 int16_t gShunt;
 int16_t gTemp;
 float gVoffset;
+static fix_t voffset = FIX_ONE;		  // gVoffset for the per-loop arithmetic
 int16_t gVoltage;
 uint16_t gDCA;
 uint16_t gCCA;
@@ -80,60 +128,71 @@ int16_t gMinhour, gMinday;
 int16_t gSelfDischarge;
 int16_t gIdleCurrent;
 
-CTX2438_t Result;
-
 uint32_t self_discharge_time;
 
-uint8_t ids[4][OW_ROMCODE_SIZE];	// only expect to find up to 3 actually!!
 int8_t battid = -1, gpioid = -1, thermid = -1;
 
 #if DEBUG > 0
-int16_t gLoops = 0;
+int16_t gLoops = 0;				  // new readings from the main bank per minute
+int16_t gPasses = 0;				  // times through run_measure per minute
 #endif
 
 
 void
 measure_init(void)
 {
-	uint8_t diff, cnt = 0;
+	uint8_t i;
+	int16_t charge;
 
-	for (diff = OW_SEARCH_FIRST, cnt = 0; diff != OW_LAST_DEVICE; cnt++)
-	{
-		diff = ow_rom_search(diff, ids[cnt]);
-
-		if ((diff == OW_PRESENCE_ERR) || (diff == OW_DATA_ERR))
-			break;					  // <--- early exit!
-
-#if DEBUG > 0
-		kfile_printf(&serial.fd, "Found device %02x:%02x%02x%02x%02x%02x%02x:%02x\r\n", ids[cnt][0], ids[cnt][1],
-						 ids[cnt][2], ids[cnt][3], ids[cnt][4], ids[cnt][5], ids[cnt][6], ids[cnt][7]);
-		if (crc8(ids[cnt], 8))
-			kfile_print(&serial.fd, "CRC suspect\r\n");
-#endif
-		if (ids[cnt][0] == SBATTERY_FAM)
-			battid = cnt;
-		if (ids[cnt][0] == SSWITCH_FAM)
-			gpioid = cnt;
-		if ((ids[cnt][0] == DS18S20_FAMILY_CODE) || (ids[cnt][0] == DS18B20_FAMILY_CODE) || (ids[cnt][0] == DS1822_FAMILY_CODE))
-			thermid = cnt;
+	// find what's on the bus and which slots they have
+	owdev_init();
+	battid = owdev_find(OWDEV_BATTERY, 0);
+	gpioid = owdev_find(OWDEV_SWITCH, 0);
+	thermid = owdev_find(OWDEV_THERM, 0);
 
-	}
-	median_init(&AmpsMedian, 10);
-	median_init(&VoltsMedian, 10);
 	median_init(&TempMedian, 10);
 
-	minmax_init(&hourmax, 60, true);
-	minmax_init(&hourmin, 60, false);
-	minmax_init(&daymax, 24, true);
-	minmax_init(&daymin, 24, false);
+	minmax2_init(&hourminmax, 60);
+	minmax2_init(&dayminmax, 24);
 
-	if (battid >= 0)                // see if a DS2438 chip is present
+	for (i = 0; i < MAX_BANKS; i++)
 	{
+		banks[i].dev = owdev_find(OWDEV_BATTERY, i);
+		median_init(&banks[i].Amps, 10);
+		median_init(&banks[i].Volts, 10);
+		banks[i].state = ACQ_START;
+		// so the first reading is taken straight away
+		banks[i].started = timer_clock() - ms_to_ticks(BANK_PERIOD);
+		if (banks[i].dev < 0)
+			continue;
+
 		// load last saved charge value from eeprom
-		eeprom_read_block((void *) &gCharge, (const void *) &eeCharge, sizeof(gCharge));
+		if (i == 0)
+		{
+			eeprom_read_block((void *) &gCharge, (const void *) &eeCharge, sizeof(gCharge));
+			charge = gCharge;
+		}
+		else
+		{
+			eeprom_read_block((void *) &charge, (const void *) &eeBankCharge[i - 1], sizeof(charge));
+			if (charge < 0)
+				charge = 0;
+		}
 		// set mode and init expanded charge handler
-		ow_ds2438_init(ids[battid], &Result, 1.0 / gShunt, gCharge);
+		ow_ds2438_init(owdev[banks[i].dev].rom, &banks[i].Result, 1.0 / gShunt, charge);
 	}
+
+	for (i = 0; i < MAX_THERMS; i++)
+	{
+		therms[i].dev = owdev_find(OWDEV_THERM, i);
+		median_init(&therms[i].Temp, 10);
+		therms[i].converting = false;
+		// read them all straight away
+		therms[i].started = timer_clock() - ms_to_ticks(THERM_PERIOD);
+		if (therms[i].dev >= 0)
+			ow_ds18x20_resolution(owdev[therms[i].dev].rom, DS18X20_RESOLUTION);
+	}
+
 	// load last saved discharge time from eeprom
 	eeprom_read_block((void *) &self_discharge_time, (const void *) &eeSelfLeakTime, sizeof(self_discharge_time));
 
@@ -145,7 +204,7 @@ do_calibration(void)
 {
 
 	// zero the current offset register
-	return ow_ds2438_calibrate(ids[battid], &Result, 0);
+	return ow_ds2438_calibrate(owdev[battid].rom, &banks[0].Result, 0);
 }
 
 
@@ -159,15 +218,15 @@ do_CCADCA(int16_t percent, int16_t base)
 	else
 		t = (float)percent / 100.0;
 	// if we haven't yet got anything recorded, then start at an arbitrary non-zero position
-	if (Result.CCA < 10)
-		Result.CCA = 10;
+	if (banks[0].Result.CCA < 10)
+		banks[0].Result.CCA = 10;
 	// if we are passing in a value then use it
 	if (base > 0)
-		Result.CCA = base;
+		banks[0].Result.CCA = base;
 
 	// initialisation sets charge efficiency to 90%
-	Result.DCA = (float)Result.CCA * t;
-	return ow_ds2438_setCCADCA(ids[battid], &Result);
+	banks[0].Result.DCA = (float)banks[0].Result.CCA * t;
+	return ow_ds2438_setCCADCA(owdev[battid].rom, &banks[0].Result);
 }
 
 
@@ -186,75 +245,224 @@ void
 set_charge(uint16_t value)
 {
 	gCharge = value;
-	ow_ds2438_init(ids[battid], &Result, 1.0 / gShunt, gCharge);
+	ow_ds2438_init(owdev[battid].rom, &banks[0].Result, 1.0 / gShunt, gCharge);
 	eeprom_write_block((const void *) &gCharge, (void *) &eeCharge, sizeof(gCharge));
 }
 
 
+// take a fixed point copy of the voltage calibration factor for run_measure. Needs calling whenever gVoffset changes.
+void
+update_voffset(void)
+{
+	voffset = fix_from_float(gVoffset);
+}
+
+// move a battery monitor's conversion on a step, returns true if it used the bus. The main bank's
+// readings are dealt with by run_measure, the others just keep their own filtered figures
+static bool
+bank_step(BANK *B)
+{
+	if (B->dev < 0)
+		return false;
+
+	switch (B->state)
+	{
+	case ACQ_START:
+		if (timer_clock() - B->started < owdev_period(B->dev, ms_to_ticks(BANK_PERIOD)))
+			return false;
+		// temperature first, the current ADC runs continuously so needs no start
+		ow_command(DS2438_CONVERT_T, owdev[B->dev].rom);
+		B->started = timer_clock();
+		B->state = ACQ_TEMP;
+		break;
+
+	case ACQ_TEMP:
+		if (timer_clock() - B->started < ms_to_ticks(DS2438_CONVERT_TIME))
+			return false;
+		ow_command(DS2438_CONVERT_V, owdev[B->dev].rom);
+		// time the volts conversion from when it really started, this step may have run late
+		B->started = timer_clock();
+		B->tries = 0;
+		B->state = ACQ_VOLTS;
+		break;
+
+	case ACQ_VOLTS:
+		if (timer_clock() - B->started < ms_to_ticks(DS2438_CONVERT_TIME))
+			return false;
+		if (ow_ds2438_readall(owdev[B->dev].rom, &B->Result))
+		{
+			owdev_ok(B->dev);
+			B->state = ACQ_START;
+			// for current we get the median and the average values. Median removes glitches, average smooths bumps!
+			median_add(&B->Amps, B->Result.Amps);
+			// volts = as returned scaled by external divider; already scaled by 100, adjusted by calibration offset
+			median_add(&B->Volts, fix_scale(B->Result.Volts * gVoltage / NOMINALVOLTS, voffset));
+			B->fresh = true;
+		}
+		else
+		{
+			owdev_failed(B->dev);
+			// bad read - the results are still in the chip so just read again next time round
+			if (++B->tries < DS2438_READ_TRIES)
+				owdev_retry(B->dev);
+			else
+				B->state = ACQ_START;
+		}
+		break;
+	}
+
+	return true;
+}
+
+
+// move a thermometer's conversion on a step, returns true if it used the bus. The conversion is
+// started and the result picked up on a pass once it has had time to finish
+static bool
+therm_step(THERM *T)
+{
+	int16_t temperature;
+
+	if (T->dev < 0)
+		return false;
+
+	if (!T->converting)
+	{
+		if (timer_clock() - T->started < owdev_period(T->dev, ms_to_ticks(THERM_PERIOD)))
+			return false;
+		ow_ds18X20_start (owdev[T->dev].rom, false);
+		T->started = timer_clock();
+		T->converting = true;
+		return true;
+	}
+
+	if (timer_clock() - T->started < ms_to_ticks(DS18X20_CONVERT_TIME))
+		return false;
+
+	T->converting = false;
+	if (ow_ds18X20_read_temperature (owdev[T->dev].rom, &temperature))
+	{
+		owdev_ok(T->dev);
+		// smoothing function using a running average in a history buffer gets rid of glitches
+		median_add(&T->Temp, temperature);
+		// the first thermometer is the one used for temperature compensation
+		if (T == &therms[0])
+			median_getAverage(&T->Temp, &gTemp);
+	}
+	else
+		owdev_failed(T->dev);
+	return true;
+}
+
+
+// give the next device that wants the bus its turn, so however many there are only one of them
+// is dealt with on any pass
+static void
+poll_devices(void)
+{
+	static uint8_t turn = 0;
+	uint8_t i;
+
+	for (i = 0; i < MAX_BANKS + MAX_THERMS; i++)
+	{
+		turn = (turn + 1) % (MAX_BANKS + MAX_THERMS);
+		if (turn < MAX_BANKS ? bank_step(&banks[turn]) : therm_step(&therms[turn - MAX_BANKS]))
+			break;
+	}
+}
+
+
+// list the battery monitors and thermometers with what they last read, for the 'config' command
+void
+measure_report(void)
+{
+	uint8_t i;
+	int16_t volts, amps, temp;
+
+	for (i = 0; i < MAX_BANKS; i++)
+	{
+		if (banks[i].dev < 0)
+			continue;
+		median_getAverage(&banks[i].Volts, &volts);
+		median_getAverage(&banks[i].Amps, &amps);
+		kfile_printf(&serial.fd, "Bank %d (slot %d)         %d.%02u V  %d.%02u A  %d Ah\r\n", i, banks[i].dev,
+						 volts / 100, abs(volts % 100), amps / 100, abs(amps % 100), banks[i].Result.Charge);
+	}
+	for (i = 0; i < MAX_THERMS; i++)
+	{
+		if (therms[i].dev < 0)
+			continue;
+		median_getAverage(&therms[i].Temp, &temp);
+		kfile_printf(&serial.fd, "Thermometer %d (slot %d)  %d.%02u C\r\n", i, therms[i].dev, temp / 100, abs(temp % 100));
+	}
+}
+
+
 void
 run_measure(void)
 {
-	float tmp;
 	int16_t amps;
-	static int8_t firstrun = true;
 	static uint16_t lastcharge;
-	static uint32_t lastmin = 0, lasthour = 0, lastday = 0;
+	static uint8_t ticks = 0;
 	int16_t power;
+	uint8_t i;
 #if DEBUG > 0
 	static uint16_t loopcount = 0;
+	static uint16_t passcount = 0;
 #endif
 
-	if (firstrun)
-	{
-		firstrun = false;
+	// remember which periods have finished in case this pass is cut short before they're dealt with
+	ticks |= rollup_ticks();
 
-		lastmin = uptime();
-		lasthour = uptime();
-		lastday = uptime();
-	}
+#if DEBUG > 0
+	// come through here every iteration so count how often
+	passcount++;
+#endif
+
+	poll_devices();
 
 	if (battid == -1)				  // see if a DS2438 chip is present
 	{
 		// dummy values if no hardware to read from
 		gVolts = gVoltage * 105;
-		gCharge = gBankSize * 0.90;
+		gCharge = fix_scale(gBankSize, FIX(0.90));
 		return;
 	}
 
-	ow_ds2438_doconvert(ids[battid]);
-	if (!ow_ds2438_readall(ids[battid], &Result))
-		return;						  // bad read - exit fast!!
+	// nothing more to do until the main bank has a new set of readings
+	if (!banks[0].fresh)
+		return;
+	banks[0].fresh = false;
+
+#if DEBUG > 0
+	loopcount++;
+#endif
 
 	// see if an external temperature sensor - if not then use what we have!!
 	if (thermid == -1)
 	{
 		// smoothing function using a running average in a history buffer gets rid of glitches
-		median_add(&TempMedian, Result.Temp);
+		median_add(&TempMedian, banks[0].Result.Temp);
 		median_getAverage(&TempMedian, &gTemp);
 	}
 
 	// for current we get the median and the average values. Median removes glitches, average smooths bumps!
-	median_add(&AmpsMedian, Result.Amps);
-	median_getMedian(&AmpsMedian, &amps);
-	median_getAverage(&AmpsMedian, &gAmps);
+	median_getMedian(&banks[0].Amps, &amps);
+	median_getAverage(&banks[0].Amps, &gAmps);
 
-	// volts = as returned scaled by external divider; already scaled by 100, adjusted by calibration offset
-	median_add(&VoltsMedian, (Result.Volts * gVoltage / NOMINALVOLTS) * gVoffset);
 	// instantanious volts
-	median_getMedian(&VoltsMedian, &iVolts);
+	median_getMedian(&banks[0].Volts, &iVolts);
 	// smoothed (average) volts
-	median_getAverage(&VoltsMedian, &gVolts);
+	median_getAverage(&banks[0].Volts, &gVolts);
 
-	tmp = (float)gAmps * (float)gVolts;
 	// volts & amps are scaled by 100 each so loose 10,000
-	gPower = (int16_t) (tmp / 10000.0);
+	gPower = fix_muldiv(gAmps, gVolts, 10000);
 
 	// charge totals
-	gCCA = Result.CCA;
-	gDCA = Result.DCA;
+	gCCA = banks[0].Result.CCA;
+	gDCA = banks[0].Result.DCA;
 
 	// remaining capacity (amp-hrs)
-	gCharge = Result.Charge;
+	gCharge = banks[0].Result.Charge;
 
 	// if the charge level has changed a lot the stash away in eeprom
 	if (abs(lastcharge - gCharge) > 20)
@@ -273,9 +481,8 @@ run_measure(void)
 	// we scan the array of 24 hours and keep the maximum value for the UI to display
 	// same goes for minimum values.
 
-	tmp = (float)amps * (float)iVolts;
 	// volts & amps are scaled by 100 each so loose 10,000
-	power = (int16_t) (tmp / 10000.0);
+	power = fix_muldiv(amps, iVolts, 10000);
 
 	// log new power events while we have all the constituent values available
 	if (power > gMaxhour)
@@ -288,75 +495,59 @@ run_measure(void)
 	if (power < gMinday)
 		log_event(LOG_NEWDAYMIN);
 
-#if DEBUG > 0
-	// come through here every iteration so count how often
-	loopcount++;
-#endif
-
 	// see if a minute has passed, if so advance the pointer to track the last hour
-	if (uptime() >= lastmin + 60)
+	if (ticks & ROLLUP_TICK(ROLLUP_MINUTE))
 	{
+		ticks &= ~ROLLUP_TICK(ROLLUP_MINUTE);
 #if DEBUG > 0
 		int32_t tmp0; //calcs must be done in 32-bit math to avoid overflow
 		tmp0 = gLoops * 59 + loopcount;
 		gLoops = tmp0 / 60;
 		loopcount = 0;
+		tmp0 = gPasses * 59 + passcount;
+		gPasses = tmp0 / 60;
+		passcount = 0;
 #endif
-		lastmin = uptime();
-		minmax_add(&hourmax);
-		minmax_add(&hourmin);
-
-		// once per minute, try for an update from the external temperature sensor (if we have one)
-		if (thermid >=0)
-		{
-			int16_t temperature;
-			// select lowest resolution so its fast
-			ow_ds18x20_resolution(ids[thermid], 9);
-			ow_ds18X20_start (ids[thermid], false);
-			while (ow_busy ());
-			ow_ds18X20_read_temperature (ids[thermid], &temperature);
-			median_add(&TempMedian, temperature);
-			median_getAverage(&TempMedian, &gTemp);
-		}
+		minmax2_add(&hourminmax);
 	}
 
 	// save the present power level if greater than already there
-	gMaxhour = minmax_get(&hourmax, power);
-	gMinhour = minmax_get(&hourmin, power);
+	minmax2_get(&hourminmax, power, power, &gMaxhour, &gMinhour);
 
 	// see if we have finished an hour, if so then move to a new hour
-	if (uptime() >= lasthour + 3600)
+	if (ticks & ROLLUP_TICK(ROLLUP_HOUR))
 	{
-		lasthour = uptime();
-		minmax_add(&daymax);
-		minmax_add(&daymin);
+		ticks &= ~ROLLUP_TICK(ROLLUP_HOUR);
+		minmax2_add(&dayminmax);
 
 		// once per hour save the charge level into eeprom
 		lastcharge = gCharge;
 		eeprom_write_block((const void *) &gCharge, (void *) &eeCharge, sizeof(gCharge));
+		for (i = 1; i < MAX_BANKS; i++)
+			if (banks[i].dev >= 0)
+				eeprom_write_block((const void *) &banks[i].Result.Charge, (void *) &eeBankCharge[i - 1], sizeof(banks[i].Result.Charge));
 	}
 
-	gMaxday = minmax_get(&daymax, gMaxhour);
-	gMinday = minmax_get(&daymin, gMinhour);
+	minmax2_get(&dayminmax, gMaxhour, gMinhour, &gMaxday, &gMinday);
 
 	// pessimistically assume 1% loss of battery charge per unit time - units in days
-	if (time() >= (self_discharge_time + (uint32_t) ((float)gSelfDischarge * 3600.0 * 24.0)))
+	if (time() >= (self_discharge_time + (uint32_t) gSelfDischarge * 3600UL * 24UL))
 	{
 		self_discharge_time = time();
-		gCharge *= 0.99;
-		ow_ds2438_init(ids[battid], &Result, 1.0 / gShunt, gCharge);
+		gCharge = fix_scale(gCharge, FIX(0.99));
+		ow_ds2438_init(owdev[battid].rom, &banks[0].Result, 1.0 / gShunt, gCharge);
 		eeprom_write_block((const void *) &self_discharge_time, (void *) &eeSelfLeakTime, sizeof(self_discharge_time));
 		log_event(LOG_LEAKADJUST);
 	}
 
 	// see if we have finished a day, if so then total up the idle current
-	if (uptime() >= lastday + 86400)
+	if (ticks & ROLLUP_TICK(ROLLUP_DAY))
 	{
 		uint16_t total_idle;
 
-		lastday = uptime();
+		ticks &= ~ROLLUP_TICK(ROLLUP_DAY);
 		gCharge -= gIdleCurrent * 24 / 100;
-		ow_ds2438_init(ids[battid], &Result, 1.0 / gShunt, gCharge);
+		ow_ds2438_init(owdev[battid].rom, &banks[0].Result, 1.0 / gShunt, gCharge);
 		log_event(LOG_IDLEADJUST);
 		// keep a running total of idle current until its big enough to influence DCA register
 		eeprom_read_block((void *) &total_idle, (const void *) &eeIdleTotal, sizeof(total_idle));
@@ -364,8 +555,8 @@ run_measure(void)
 		if (total_idle > 64)
 		{
 			// indicate that more charge has gone from the battery
-			Result.DCA += total_idle;
-			ow_ds2438_setCCADCA(ids[battid], &Result);
+			banks[0].Result.DCA += total_idle;
+			ow_ds2438_setCCADCA(owdev[battid].rom, &banks[0].Result);
 			total_idle = 0;
 		}
 		eeprom_write_block((const void *) &total_idle, (void *) &eeIdleTotal, sizeof(total_idle));
@@ -25,6 +25,13 @@
 #include <avr/eeprom.h>
 #include <drv/ow_1wire.h>
 
+#include "owdev.h"
+
+// battery monitors and external thermometers that are read, the first of each is
+// the one the controller runs from
+#define MAX_BANKS  2
+#define MAX_THERMS 4
+
 extern int16_t gVolts;
 extern int16_t iVolts;
 extern int16_t gAmps;
@@ -37,7 +44,6 @@ extern uint16_t gCCA;
 extern int16_t gCharge;
 extern int16_t gMaxhour, gMaxday;
 extern int16_t gMinhour, gMinday;
-extern uint8_t ids[][OW_ROMCODE_SIZE];
 extern int8_t battid, gpioid;
 extern int16_t gSelfDischarge;
 extern int16_t gIdleCurrent;
@@ -49,6 +55,8 @@ extern uint32_t self_discharge_time;
 
 void measure_init (void);
 void run_measure (void);
+void update_voffset (void);
+void measure_report (void);
 char do_dump (char input);
 char do_sync (char input);
 void do_first_init(void);
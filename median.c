@@ -35,54 +35,98 @@
 
 #define constrain(amt,low,high) ((amt)<(low)?(low):((amt)>(high)?(high):(amt)))
 
+// full sort of the live values into as[], only needed when ar[] has been filled from somewhere else
 static void sort(MEDIAN *M) 
 {
 	// copy
-	for (uint8_t i=0; i< M->cnt; i++) M->as[i] = M->ar[i];
+	M->sum = 0;
+	for (uint8_t i=0; i< M->s.cnt; i++) {
+		M->s.as[i] = M->s.ar[i];
+		M->sum += M->s.ar[i];
+	}
 
 	// sort all
-	for (uint8_t i=0; i< M->cnt-1; i++) {
+	for (uint8_t i=0; i< M->s.cnt-1; i++) {
 		uint8_t m = i;
-		for (uint8_t j=i+1; j< M->cnt; j++) {
-			if (M->as[j] < M->as[m]) m = j;
+		for (uint8_t j=i+1; j< M->s.cnt; j++) {
+			if (M->s.as[j] < M->s.as[m]) m = j;
 		}
 		if (m != i) {
-			int16_t t = M->as[m];
-			M->as[m] = M->as[i];
-			M->as[i] = t;
+			int16_t t = M->s.as[m];
+			M->s.as[m] = M->s.as[i];
+			M->s.as[i] = t;
 		}
 	}
 }
 
+// binary search of the first n entries of the sorted array for the first entry not less than value
+static uint8_t find(const int16_t *as, uint8_t n, int16_t value)
+{
+	uint8_t lo = 0, hi = n;
+
+	while (lo < hi) {
+		uint8_t mid = (lo + hi) / 2;
+		if (as[mid] < value) lo = mid + 1;
+		else hi = mid;
+	}
+	return lo;
+}
+
 
 //< Initialise the buffering array and all variables for this instance
 //< \param M pointer to a struct that holds the variables for this instance of median calculator
 // < \param size number of entries in the array
 void median_init(MEDIAN *M,  uint8_t size)
 {
-	M->size = constrain(size, MIN_MEDIAN, MAX_MEDIAN);
-	M->cnt = 0;
-	M->idx = 0;
-	memset(M->ar, 0, M->size * sizeof(M->ar[0]));
+	M->s.size = constrain(size, MIN_MEDIAN, MAX_MEDIAN);
+	M->s.cnt = 0;
+	M->s.idx = 0;
+	M->sum = 0;
+	memset(M->s.ar, 0, M->s.size * sizeof(M->s.ar[0]));
 }
 
 //< Clears the variables used to build the median array
 //< \param M pointer to a struct that holds the variables for this instance of median calculator
 void median_clear(MEDIAN *M) 
 {
-	M->cnt = 0;
-	M->idx = 0;
+	M->s.cnt = 0;
+	M->s.idx = 0;
+	M->sum = 0;
 }
 
 
 //< Adds a value to the median array, updates and wraps indices discarding expired data.
+//< The sorted copy and the sum are kept up to date here so the queries don't have to go through the array.
 //< \param M pointer to a struct that holds the variables for this instance of median calculator
 //< \param value 16 bit signed value to add to median array
 void median_add(MEDIAN *M, int16_t value)
 {
-	M->ar[M->idx++] = value;
-	if (M->idx >= M->size) M->idx = 0; // wrap around
-	if (M->cnt < M->size) M->cnt++;
+	uint8_t n = M->s.cnt;
+	uint8_t pos;
+
+	// a full array loses the value about to be overwritten from the sorted copy as well
+	if (n >= M->s.size) {
+		pos = find(M->s.as, n, M->s.ar[M->s.idx]);
+		n--;
+		memmove(&M->s.as[pos], &M->s.as[pos + 1], (n - pos) * sizeof(M->s.as[0]));
+		M->sum -= M->s.ar[M->s.idx];
+	}
+
+	pos = find(M->s.as, n, value);
+	memmove(&M->s.as[pos + 1], &M->s.as[pos], (n - pos) * sizeof(M->s.as[0]));
+	M->s.as[pos] = value;
+	M->sum += value;
+
+	M->s.ar[M->s.idx++] = value;
+	if (M->s.idx >= M->s.size) M->s.idx = 0; // wrap around
+	if (M->s.cnt < M->s.size) M->s.cnt++;
+}
+
+//< Rebuilds the sorted copy and the sum of the array after M->s has been loaded from elsewhere (eeprom)
+//< \param M pointer to a struct that holds the variables for this instance of median calculator
+void median_rebuild(MEDIAN *M)
+{
+	sort(M);
 }
 
 //< Gets the value from the supplied index in the array
@@ -92,23 +136,22 @@ void median_add(MEDIAN *M, int16_t value)
 bool median_getNext(MEDIAN *M, uint8_t *index, int16_t *value)
 {
 	uint8_t idx = *index;
-	if (M->cnt > 0) {
-		*value = M->ar[idx++];
-		if (idx >= M->size) idx = 0;
+	if (M->s.cnt > 0) {
+		*value = M->s.ar[idx++];
+		if (idx >= M->s.size) idx = 0;
 		*index = idx;
 		return OK;
 	}
 	return NOK;
 }
 
-//< Sort the median array and return the centre of the sorted array
+//< Return the centre of the sorted median array
 //< \param M pointer to a struct that holds the variables for this instance of median calculator
 //< \param value pointer to value returned from the centre of the sorted median array
 bool median_getMedian(MEDIAN *M, int16_t *value)
 {
-	if (M->cnt > 0) {
-		sort(M);
-		*value = M->as[M->cnt/2];
+	if (M->s.cnt > 0) {
+		*value = M->s.as[M->s.cnt/2];
 		return OK;
 	}
 	return NOK;
@@ -119,10 +162,8 @@ bool median_getMedian(MEDIAN *M, int16_t *value)
 //< \param value pointer to average value returned
 bool median_getAverage(MEDIAN *M, int16_t *value) 
 {
-	if (M->cnt > 0) {
-		float sum = 0;
-		for (uint8_t i=0; i< M->cnt; i++) sum += M->ar[i];
-		*value = sum / M->cnt;
+	if (M->s.cnt > 0) {
+		*value = M->sum / M->s.cnt;
 		return OK;
 	}
 	return NOK;
@@ -133,9 +174,8 @@ bool median_getAverage(MEDIAN *M, int16_t *value)
 //< \param value pointer to value highest value returned
 bool median_getHighest(MEDIAN *M, int16_t *value) 
 {
-	if (M->cnt > 0) {
-		sort(M);
-		*value = M->as[M->cnt-1];
+	if (M->s.cnt > 0) {
+		*value = M->s.as[M->s.cnt-1];
 		return OK;
 	}
 	return NOK;
@@ -147,9 +187,8 @@ bool median_getHighest(MEDIAN *M, int16_t *value)
 //< \param value pointer to value lowest value returned
 bool median_getLowest(MEDIAN *M, int16_t *value) 
 {
-	if (M->cnt > 0) {
-		sort(M);
-		*value =  M->as[0];
+	if (M->s.cnt > 0) {
+		*value =  M->s.as[0];
 		return OK;
 	}
 	return NOK;
@@ -160,28 +199,28 @@ bool median_getLowest(MEDIAN *M, int16_t *value)
 //< \return index into median array where data starts (opposite end to where we write!!)
 uint8_t median_getStart(MEDIAN *M) 
 {
-	return M->idx;
+	return M->s.idx;
 }
 
 //< \param M pointer to a struct that holds the variables for this instance of median calculator
 //< \return size of median array
 uint8_t median_getSize(MEDIAN *M) 
 {
-	return M->size;
+	return M->s.size;
 }
 
 //< \param M pointer to a struct that holds the variables for this instance of median calculator
 //< \return number of entries so far in the median array
 uint8_t median_getCount(MEDIAN *M) 
 {
-	return M->cnt;
+	return M->s.cnt;
 }
 
 //< \param M pointer to a struct that holds the variables for this instance of median calculator
 //< \return whether there are any entries at all in the median array
 bool median_getStatus(MEDIAN *M) 
 {
-	return (M->cnt > 0 ? OK : NOK);
+	return (M->s.cnt > 0 ? OK : NOK);
 }
 
 
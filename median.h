@@ -23,18 +23,25 @@
 #define OK true
 #define NOK false
 
-typedef struct running_median {
+// the part that's kept in eeprom, laid out as it always has been
+typedef struct running_median_store {
    int16_t ar[MAX_MEDIAN];
    int16_t as[MAX_MEDIAN];
    uint8_t idx;
    uint8_t cnt;
    uint8_t size;
+} MEDIAN_STORE;
+
+typedef struct running_median {
+   MEDIAN_STORE s;
+   int32_t sum;		// of the cnt values in ar[], worked out again by median_rebuild
 } MEDIAN;
 
 
 void median_init(MEDIAN *M,  uint8_t size);
 void median_clear(MEDIAN *M);
 void median_add(MEDIAN *M, int16_t value);
+void median_rebuild(MEDIAN *M);
 bool median_getMedian(MEDIAN *M, int16_t * value);
 bool median_getAverage(MEDIAN *M, int16_t *value);
 bool median_getHighest(MEDIAN *M, int16_t *value);
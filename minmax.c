@@ -25,16 +25,66 @@
 
 #define constrain(amt,low,high) ((amt)<(low)?(low):((amt)>(high)?(high):(amt)))
 
+// The slots that have finished are kept in a queue, oldest first, with each one's value beating all of
+// those after it. A slot that is beaten by a newer one can never be the answer again so it is dropped,
+// which leaves the answer for the finished slots at the front of the queue. The current slot is still
+// changing so it is compared separately.
+
+// true if a is at least as good as b when looking for the max (or the min)
+static bool beats(bool max, int16_t a, int16_t b)
+{
+	return max ? (a >= b) : (a <= b);
+}
+
+// position in the queue that is n entries after the oldest one
+static minmax_index_t position(MINMAX_QUEUE *Q, minmax_index_t size, minmax_index_t n)
+{
+	uint16_t pos = (uint16_t) Q->first + n;
+
+	if (pos >= size)
+		pos -= size;
+	return pos;
+}
+
+// put the slot just finished on the end of the queue, dropping any older ones it beats
+static void queue_push(MINMAX_QUEUE *Q, const int16_t *data, minmax_index_t size, minmax_index_t slot, bool max)
+{
+	while (Q->count > 0 && beats (max, data[slot], data[Q->order[position (Q, size, Q->count - 1)]]))
+		Q->count--;
+	Q->order[position (Q, size, Q->count)] = slot;
+	Q->count++;
+}
+
+// the slot being reused has dropped out of the period
+static void queue_expire(MINMAX_QUEUE *Q, minmax_index_t size, minmax_index_t slot)
+{
+	if (Q->count > 0 && Q->order[Q->first] == slot)
+	{
+		Q->first = position (Q, size, 1);
+		Q->count--;
+	}
+}
+
+// the best of the current slot and the finished ones
+static int16_t queue_best(MINMAX_QUEUE *Q, const int16_t *data, int16_t current, bool max)
+{
+	if (Q->count > 0 && beats (max, data[Q->order[Q->first]], current))
+		return data[Q->order[Q->first]];
+	return current;
+}
+
 //< \param MM pointer to a struct that holds the variables for this instance
 //< \param size how large the min/max array is (seconds, minutes, hours etc)
 //< \param minmax indicates whether we're finding the min or the max value over the period
 void minmax_init(MINMAX *MM, int16_t size, bool minmax)
 {
-	int8_t j;
+	minmax_index_t j;
 	
 	MM->size = constrain(size, MIN_MINMAX, MAX_MINMAX);
 	MM->minmax = minmax;
 	MM->idx = 0;
+	MM->queue.first = 0;
+	MM->queue.count = 0;
 
 	for (j = 0; j < MM->size; j++)
 	{
@@ -48,12 +98,14 @@ void minmax_init(MINMAX *MM, int16_t size, bool minmax)
 //< \param MM pointer to a struct that holds the variables for this instance
 void minmax_add (MINMAX *MM)
 {
+	queue_push (&MM->queue, MM->data, MM->size, MM->idx, MM->minmax);
 
 	MM->idx++;
 	if (MM->idx >= MM->size)
 		MM->idx = 0;               // reset to the start of the array
 	MM->data[MM->idx] = MM->minmax ? -32767: 32767;    // clear the next slot in the array
 
+	queue_expire (&MM->queue, MM->size, MM->idx);
 }
 
 
@@ -63,36 +115,66 @@ void minmax_add (MINMAX *MM)
 //< \return the current min or max value
 int16_t minmax_get (MINMAX *MM, int16_t value)
 {
+	// save the present value if better than already there in the current slot
+	if (!beats (MM->minmax, MM->data[MM->idx], value))
+		MM->data[MM->idx] = value;
 
-	int16_t ret;
-	int8_t j;
+	return queue_best (&MM->queue, MM->data, MM->data[MM->idx], MM->minmax);
+}
 
-	if (MM->minmax)
-	{
-		// save the present value if greater than already there in the current slot
-		if (value > MM->data[MM->idx])
-			MM->data[MM->idx] = value;
-		// find a new maximum and return it
-		ret = -32767;
-		for (j = 0; j < MM->size; j++)
-			if (MM->data[j] > ret)
-				ret = MM->data[j];
-	}
-	else
+
+//< \param MM pointer to a struct that holds the variables for this instance
+//< \param size how large the min/max arrays are (seconds, minutes, hours etc)
+void minmax2_init(MINMAX2 *MM, int16_t size)
+{
+	minmax_index_t j;
+
+	MM->size = constrain(size, MIN_MINMAX, MAX_MINMAX);
+	MM->idx = 0;
+	MM->highqueue.first = 0;
+	MM->highqueue.count = 0;
+	MM->lowqueue.first = 0;
+	MM->lowqueue.count = 0;
+
+	for (j = 0; j < MM->size; j++)
 	{
-		// save the present value if less than already there in the current slot
-		if (value < MM->data[MM->idx])
-			MM->data[MM->idx] = value;
-		// find a new minimum and return it
-		ret = 32767;
-		for (j = 0; j < MM->size; j++)
-			if (MM->data[j] < ret)
-				ret = MM->data[j];
+		MM->high[j] = -32767;
+		MM->low[j] = 32767;
 	}
-
-	return ret;
 }
 
 
+// Advance the internal pointers at the appropriate time
+//< \param MM pointer to a struct that holds the variables for this instance
+void minmax2_add (MINMAX2 *MM)
+{
+	queue_push (&MM->highqueue, MM->high, MM->size, MM->idx, true);
+	queue_push (&MM->lowqueue, MM->low, MM->size, MM->idx, false);
+
+	MM->idx++;
+	if (MM->idx >= MM->size)
+		MM->idx = 0;               // reset to the start of the array
+	MM->high[MM->idx] = -32767;    // clear the next slot in the arrays
+	MM->low[MM->idx] = 32767;
+
+	queue_expire (&MM->highqueue, MM->size, MM->idx);
+	queue_expire (&MM->lowqueue, MM->size, MM->idx);
+}
 
 
+// Keep the current slot updated and return both the min and the max for the period
+//< \param MM pointer to a struct that holds the variables for this instance
+//< \param high New value to try for the max
+//< \param low New value to try for the min (the same as high unless tracking something already min/maxed)
+//< \param max where to put the current max value
+//< \param min where to put the current min value
+void minmax2_get (MINMAX2 *MM, int16_t high, int16_t low, int16_t *max, int16_t *min)
+{
+	if (high > MM->high[MM->idx])
+		MM->high[MM->idx] = high;
+	if (low < MM->low[MM->idx])
+		MM->low[MM->idx] = low;
+
+	*max = queue_best (&MM->highqueue, MM->high, MM->high[MM->idx], true);
+	*min = queue_best (&MM->lowqueue, MM->low, MM->low[MM->idx], false);
+}
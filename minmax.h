@@ -31,15 +31,44 @@
 #define MIN_MINMAX 1
 #define MAX_MINMAX 61
 
+// slot numbers only need a byte unless the array is made bigger
+#if MAX_MINMAX > 255
+typedef uint16_t minmax_index_t;
+#else
+typedef uint8_t minmax_index_t;
+#endif
+
+// finished slots that could still be the min/max, oldest first
+typedef struct minmax_queue {
+   minmax_index_t order[MAX_MINMAX];
+   minmax_index_t first;              // where the oldest of them is in order[]
+   minmax_index_t count;              // how many of them there are
+} MINMAX_QUEUE;
+
 typedef struct running_minmax {
    int16_t data[MAX_MINMAX];
-   uint8_t idx;
-   uint8_t size;
+   MINMAX_QUEUE queue;
+   minmax_index_t idx;
+   minmax_index_t size;
    bool minmax;
 } MINMAX;
 
+// both the min and the max over the same period, sharing the slot handling
+typedef struct running_minmax2 {
+   int16_t high[MAX_MINMAX];
+   int16_t low[MAX_MINMAX];
+   MINMAX_QUEUE highqueue;
+   MINMAX_QUEUE lowqueue;
+   minmax_index_t idx;
+   minmax_index_t size;
+} MINMAX2;
+
 void minmax_init(MINMAX *MM, int16_t size, bool minmax);
 void minmax_add (MINMAX *MM);
 int16_t minmax_get (MINMAX *MM, int16_t value);
 
+void minmax2_init(MINMAX2 *MM, int16_t size);
+void minmax2_add (MINMAX2 *MM);
+void minmax2_get (MINMAX2 *MM, int16_t high, int16_t low, int16_t *max, int16_t *min);
+
 #endif
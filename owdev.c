@@ -0,0 +1,305 @@
+//---------------------------------------------------------------------------
+// Copyright (C) 2012 Robin Gilks
+//
+//
+//  owdev.c   -   Table of the devices on the 1-wire bus
+//
+//  History:   1.0 - First release. 
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+// 
+
+// Every device found on the bus gets a slot in a table that is kept in EEPROM, so a device keeps the same
+// slot (and so the same place among the others of its kind) whatever order the search turns them up in
+// and even if another one goes missing. The table also says which devices were there last time, so at
+// startup they can just be checked for instead of searching the whole bus. The first battery monitor, switch and thermometer are the ones the
+// controller runs from, any others are read and reported on.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <avr/eeprom.h>
+
+#include <algo/crc8.h>
+
+#include <drv/ser.h>
+#include <drv/ow_1wire.h>
+#include <drv/ow_ds2438.h>
+#include <drv/ow_ds2413.h>
+#include <drv/ow_ds18x20.h>
+
+#include "features.h"
+#include "eeprommap.h"
+#include "tlog.h"
+#include "owdev.h"
+
+extern Serial serial;
+
+OWDEV owdev[MAX_OWDEV];
+OWSTATS owstats[MAX_OWDEV];
+uint16_t gOwSearchCrc;             // ROM codes with a bad CRC turned up by searches
+
+
+static uint8_t
+kind_of (uint8_t family)
+{
+	switch (family)
+	{
+	case 0x00:
+	case 0xff:						  // as left in a fresh EEPROM
+		return OWDEV_FREE;
+	case SBATTERY_FAM:
+		return OWDEV_BATTERY;
+	case SSWITCH_FAM:
+		return OWDEV_SWITCH;
+	case DS18S20_FAMILY_CODE:
+	case DS18B20_FAMILY_CODE:
+	case DS1822_FAMILY_CODE:
+		return OWDEV_THERM;
+	default:
+		return OWDEV_OTHER;
+	}
+}
+
+
+// find a slot for a device - the one it had last time, else a free one, else one whose device has gone
+static int8_t
+find_slot (uint8_t * rom)
+{
+	int8_t i;
+
+	for (i = 0; i < MAX_OWDEV; i++)
+		if (memcmp (owdev[i].rom, rom, OW_ROMCODE_SIZE) == 0)
+			return i;
+	for (i = 0; i < MAX_OWDEV; i++)
+		if (owdev[i].kind == OWDEV_FREE)
+			return i;
+	for (i = 0; i < MAX_OWDEV; i++)
+		if (!owdev[i].present)
+			return i;
+	return -1;
+}
+
+
+// save the table with a CRC so a good copy can be trusted next time. Only the bytes that have changed get written
+static void
+save_table (void)
+{
+	eeprom_update_block ((const void *) owdev, (void *) eeOwDev, sizeof (owdev));
+	eeprom_update_byte (&eeOwCrc, crc8 ((const uint8_t *) owdev, sizeof (owdev)));
+}
+
+
+// see if a device is still on the bus. This is the 'verify' from Maxim's search algorithm note: a search
+// started with no discrepancy to resolve takes the branch given by the ROM code passed in wherever two
+// devices differ, so it comes back with the same code only if that device answered all the way down
+static bool
+verify (uint8_t * rom)
+{
+	uint8_t found[OW_ROMCODE_SIZE];
+	uint8_t diff;
+
+	memcpy (found, rom, OW_ROMCODE_SIZE);
+	diff = ow_rom_search (0, found);
+	if ((diff == OW_PRESENCE_ERR) || (diff == OW_DATA_ERR))
+		return false;
+	return memcmp (found, rom, OW_ROMCODE_SIZE) == 0;
+}
+
+
+// search the bus and fit what's there into the table, returns how many devices were found
+uint8_t
+owdev_search (void)
+{
+	uint8_t rom[OW_ROMCODE_SIZE];
+	uint8_t diff, cnt = 0;
+	int8_t i;
+
+	for (i = 0; i < MAX_OWDEV; i++)
+		owdev[i].present = false;
+
+	for (diff = OW_SEARCH_FIRST; diff != OW_LAST_DEVICE;)
+	{
+		diff = ow_rom_search (diff, rom);
+
+		if ((diff == OW_PRESENCE_ERR) || (diff == OW_DATA_ERR))
+			break;					  // <--- early exit!
+
+#if DEBUG > 0
+		kfile_printf (&serial.fd, "Found device %02x:%02x%02x%02x%02x%02x%02x:%02x\r\n", rom[0], rom[1],
+						  rom[2], rom[3], rom[4], rom[5], rom[6], rom[7]);
+#endif
+		if (crc8 (rom, OW_ROMCODE_SIZE))
+		{
+			gOwSearchCrc++;
+#if DEBUG > 0
+			kfile_print (&serial.fd, "CRC suspect\r\n");
+#endif
+			continue;
+		}
+
+		i = find_slot (rom);
+		if (i < 0)
+		{
+#if DEBUG > 0
+			kfile_print (&serial.fd, "No room for device\r\n");
+#endif
+			continue;
+		}
+
+		if (memcmp (owdev[i].rom, rom, OW_ROMCODE_SIZE) != 0)
+		{
+			memcpy (owdev[i].rom, rom, OW_ROMCODE_SIZE);
+			owdev[i].kind = kind_of (rom[0]);
+#if DEBUG > 0
+			kfile_printf (&serial.fd, "New device in slot %d\r\n", i);
+#endif
+		}
+		owdev[i].present = true;
+		cnt++;
+	}
+
+	save_table ();
+	return cnt;
+}
+
+
+// use the table saved last time if it's intact and every device in it still answers, otherwise
+// search the bus. Checking a handful of known devices is quicker than a full search and means we're
+// back to regulating straight away after a brownout. New devices are only picked up by a search so
+// either have a device go missing or use the 'scan' command after adding one
+void
+owdev_init (void)
+{
+	int8_t i;
+	uint8_t cnt = 0;
+
+	eeprom_read_block ((void *) owdev, (const void *) eeOwDev, sizeof (owdev));
+	if (crc8 ((const uint8_t *) owdev, sizeof (owdev)) == eeprom_read_byte (&eeOwCrc))
+	{
+		for (i = 0; i < MAX_OWDEV; i++)
+		{
+			if (!owdev[i].present)
+				continue;
+			if (!verify (owdev[i].rom))
+				break;
+			cnt++;
+		}
+		if (i == MAX_OWDEV && cnt > 0)
+			return;
+	}
+	else
+	{
+		// nothing worth keeping
+		memset (owdev, 0xff, sizeof (owdev));
+		for (i = 0; i < MAX_OWDEV; i++)
+			owdev[i].kind = OWDEV_FREE;
+	}
+
+	owdev_search ();
+}
+
+
+// slot of the n'th device of a kind that is on the bus, -1 if there aren't that many
+int8_t
+owdev_find (uint8_t kind, uint8_t n)
+{
+	int8_t i;
+
+	for (i = 0; i < MAX_OWDEV; i++)
+	{
+		if (owdev[i].present && owdev[i].kind == kind)
+		{
+			if (n == 0)
+				return i;
+			n--;
+		}
+	}
+	return -1;
+}
+
+
+// a read from a device worked - count it and speed back up if it had been failing
+void
+owdev_ok (int8_t dev)
+{
+	OWSTATS *S = &owstats[dev];
+
+	S->reads++;
+	if (S->fails >= OWDEV_FAILS_LOG)
+		log_event (LOG_BUS);
+	S->fails = 0;
+	if (S->backoff > 0)
+		S->backoff--;
+}
+
+
+// a read from a device failed. If that device still answers a search for its own ROM code then what
+// came back must have had a bad CRC, a reset alone would be answered by anything else on the bus. Each
+// failure in a row halves how often it gets polled, so a bad cable run doesn't eat up the bus
+void
+owdev_failed (int8_t dev)
+{
+	OWSTATS *S = &owstats[dev];
+
+	if (verify (owdev[dev].rom))
+		S->crc++;
+	else
+		S->presence++;
+
+	if (S->fails < UINT8_MAX && ++S->fails == OWDEV_FAILS_LOG)
+		log_event (LOG_BUS | LOG_ERROR);
+	if (S->backoff < OWDEV_MAX_BACKOFF)
+		S->backoff++;
+}
+
+
+// a failed read is being tried again
+void
+owdev_retry (int8_t dev)
+{
+	owstats[dev].retries++;
+}
+
+
+// how long to leave between polls of a device that would normally be read every period
+uint32_t
+owdev_period (int8_t dev, uint32_t period)
+{
+	return period << owstats[dev].backoff;
+}
+
+
+// list the devices and how they've been getting on, for the 'bus' command
+void
+owdev_report (void)
+{
+	int8_t i;
+	OWSTATS *S;
+	static const char kinds[][6] = { "", "batt", "gpio", "therm", "other" };
+
+	kfile_printf (&serial.fd, "Slot ROM               Kind  Reads   CRC  Pres Retry Slow\r\n");
+	for (i = 0; i < MAX_OWDEV; i++)
+	{
+		if (owdev[i].kind == OWDEV_FREE)
+			continue;
+		S = &owstats[i];
+		kfile_printf (&serial.fd, "%d%c   %02x%02x%02x%02x%02x%02x%02x%02x  %-5s %5u %5u %5u %5u %4u\r\n",
+						  i, owdev[i].present ? ' ' : '-',
+						  owdev[i].rom[0], owdev[i].rom[1], owdev[i].rom[2], owdev[i].rom[3],
+						  owdev[i].rom[4], owdev[i].rom[5], owdev[i].rom[6], owdev[i].rom[7],
+						  kinds[owdev[i].kind], S->reads, S->crc, S->presence, S->retries, 1 << S->backoff);
+	}
+	kfile_printf (&serial.fd, "Bad ROM codes in searches %u\r\n", gOwSearchCrc);
+}
@@ -0,0 +1,80 @@
+//---------------------------------------------------------------------------
+// Copyright (C) 2012 Robin Gilks
+//
+//
+//  owdev.h   -   Table of the devices on the 1-wire bus
+//
+//  History:   1.0 - First release. 
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+// 
+#ifndef _OWDEV_H
+#define _OWDEV_H
+
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <drv/ow_1wire.h>
+
+
+// slots in the device table (and in EEPROM)
+#define MAX_OWDEV 8
+
+// what we use each family of device for
+enum OWDEV_KIND
+{
+	OWDEV_FREE,                 // unused slot
+	OWDEV_BATTERY,              // DS2438 battery monitor
+	OWDEV_SWITCH,               // DS2413 inverter switch
+	OWDEV_THERM,                // DS18x20 thermometer
+	OWDEV_OTHER                 // nothing we know what to do with
+};
+
+typedef struct owdev
+{
+	uint8_t rom[OW_ROMCODE_SIZE];
+	uint8_t kind;
+	bool present;               // found on the bus at startup
+} OWDEV;
+
+// how a device has been getting on since startup. Kept apart from the table as it isn't saved
+typedef struct owstats
+{
+	uint16_t reads;             // reads that worked
+	uint16_t crc;               // reads that came back with a bad CRC
+	uint16_t presence;          // reads where it didn't answer the reset
+	uint16_t retries;           // reads tried again after a failure
+	uint8_t fails;              // failures in a row
+	uint8_t backoff;            // polled at 1/2^backoff of the normal rate
+} OWSTATS;
+
+// failures in a row before a device is logged as having a problem
+#define OWDEV_FAILS_LOG 4
+// slowest a failing device gets polled, as a power of 2 of its normal period
+#define OWDEV_MAX_BACKOFF 5
+
+extern OWDEV owdev[MAX_OWDEV];
+extern OWSTATS owstats[MAX_OWDEV];
+extern uint16_t gOwSearchCrc;
+
+void owdev_init (void);
+uint8_t owdev_search (void);
+int8_t owdev_find (uint8_t kind, uint8_t n);
+void owdev_ok (int8_t dev);
+void owdev_failed (int8_t dev);
+void owdev_retry (int8_t dev);
+uint32_t owdev_period (int8_t dev, uint32_t period);
+void owdev_report (void);
+
+#endif
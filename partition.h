@@ -146,6 +146,22 @@ typedef uintptr_t (*device_write_callback_t)(uint8_t* buffer, offset_t offset, v
  * \see device_write_t
  */
 typedef uint8_t (*device_write_interval_t)(offset_t offset, uint8_t* buffer, uintptr_t length, device_write_callback_t callback, void* p);
+/**
+ * A function pointer used to read whole blocks from the partition in one go.
+ *
+ * \param[in] offset The offset on the device of the first block, a multiple of 512.
+ * \param[out] buffer The buffer into which to place the data.
+ * \param[in] count The count of 512 byte blocks to read.
+ */
+typedef uint8_t (*device_read_blocks_t)(offset_t offset, uint8_t* buffer, uint16_t count);
+/**
+ * A function pointer used to write whole blocks to the partition in one go.
+ *
+ * \param[in] offset The offset on the device of the first block, a multiple of 512.
+ * \param[in] buffer The buffer which to write.
+ * \param[in] count The count of 512 byte blocks to write.
+ */
+typedef uint8_t (*device_write_blocks_t)(offset_t offset, const uint8_t* buffer, uint16_t count);
 
 /**
  * Describes a partition.
@@ -180,6 +196,20 @@ struct partition_struct
      *       not to the start of the partition.
      */
     device_write_interval_t device_write_interval;
+    /**
+     * The function which reads several whole blocks with a single device command.
+     *
+     * Optional, zero if the device does not provide one. Set it after
+     * opening the partition.
+     */
+    device_read_blocks_t device_read_blocks;
+    /**
+     * The function which writes several whole blocks with a single device command.
+     *
+     * Optional, zero if the device does not provide one. Set it after
+     * opening the partition.
+     */
+    device_write_blocks_t device_write_blocks;
 
     /**
      * The type of the partition.
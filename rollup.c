@@ -0,0 +1,160 @@
+//---------------------------------------------------------------------------
+// Copyright (C) 2012 Robin Gilks
+//
+//
+//  rollup.c   -   Roll samples up into per second, minute, hour, day and month figures
+//
+//  History:   1.0 - First release. 
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+// 
+
+
+// Samples added to a channel build up the figures for the second in progress. When a period finishes its
+// mean, min and max go in as one sample of the tier above, so a minute is the sum, min and max of up to 60
+// second means and so on up. The figures for the last complete period of each tier are kept for anything
+// that wants them.
+//
+// This is also the one place that keeps track of time passing. run_rollup is called once each time round
+// the main loop and rollup_ticks tells the other modules which periods finished on this pass, so they
+// don't each need to keep their own copy of when they last did something.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <avr/pgmspace.h>
+
+#include "rtc.h"
+#include "rollup.h"
+
+// length of each tier in seconds
+static const uint32_t tier_length[ROLLUP_TIERS] PROGMEM = { 1, 60, 3600, 86400, 30 * 86400UL };
+
+static ROLLUP *channels[MAX_ROLLUP];
+static uint8_t num_channels = 0;
+static uint8_t ticks = 0;
+
+static void
+clear (ROLLUP_STATS * S)
+{
+	S->sum = 0;
+	S->min = 32767;
+	S->max = -32768;
+	S->count = 0;
+}
+
+static void
+add (ROLLUP_STATS * S, int16_t value, int16_t min, int16_t max)
+{
+	S->sum += value;
+	if (min < S->min)
+		S->min = min;
+	if (max > S->max)
+		S->max = max;
+	S->count++;
+}
+
+// add a channel to those rolled up each time a period finishes
+//< \param R the channel, starting empty
+void
+rollup_register (ROLLUP * R)
+{
+	uint8_t t;
+
+	for (t = 0; t < ROLLUP_TIERS; t++)
+	{
+		clear (&R->now[t]);
+		clear (&R->last[t]);
+	}
+
+	if (num_channels < MAX_ROLLUP)
+		channels[num_channels++] = R;
+}
+
+// see which periods have finished since the last pass and roll every channel up through them
+void
+run_rollup (void)
+{
+	static uint32_t last = 0;
+	uint32_t now = uptime ();
+	uint32_t length;
+	uint8_t c, t;
+
+	ticks = 0;
+	if (now == last)
+		return;
+
+	// a period finishes when uptime goes past a whole number of them, longer ones can finish together
+	for (t = 0; t < ROLLUP_TIERS; t++)
+	{
+		length = pgm_read_dword (&tier_length[t]);
+		if (now / length != last / length)
+			ticks |= ROLLUP_TICK (t);
+	}
+	last = now;
+
+	// lowest first so each finished period is part of the one above before that finishes too
+	for (c = 0; c < num_channels; c++)
+	{
+		ROLLUP *R = channels[c];
+
+		for (t = 0; t < ROLLUP_TIERS; t++)
+		{
+			if (!(ticks & ROLLUP_TICK (t)))
+				break;
+
+			if (R->now[t].count && (t + 1 < ROLLUP_TIERS))
+				add (&R->now[t + 1], rollup_mean (&R->now[t]), R->now[t].min, R->now[t].max);
+			R->last[t] = R->now[t];
+			clear (&R->now[t]);
+		}
+	}
+}
+
+//< \return a bit (ROLLUP_TICK) for each tier that finished a period on this pass of the main loop
+uint8_t
+rollup_ticks (void)
+{
+	return ticks;
+}
+
+//< \param R the channel
+//< \param value new sample for the second in progress
+void
+rollup_add (ROLLUP * R, int16_t value)
+{
+	add (&R->now[ROLLUP_SECOND], value, value, value);
+}
+
+//< \return the figures so far for the period in progress
+const ROLLUP_STATS *
+rollup_now (ROLLUP * R, enum ROLLUP_TIER tier)
+{
+	return &R->now[tier];
+}
+
+//< \return the figures for the last complete period, with a count of 0 if there was nothing in it
+const ROLLUP_STATS *
+rollup_last (ROLLUP * R, enum ROLLUP_TIER tier)
+{
+	return &R->last[tier];
+}
+
+//< \return the mean of the samples in a period, 0 if there weren't any
+int16_t
+rollup_mean (const ROLLUP_STATS * S)
+{
+	if (S->count == 0)
+		return 0;
+	return S->sum / S->count;
+}
@@ -0,0 +1,71 @@
+//---------------------------------------------------------------------------
+// Copyright (C) 2012 Robin Gilks
+//
+//
+//  rollup.h   -   Roll samples up into per second, minute, hour, day and month figures
+//
+//  History:   1.0 - First release. 
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+// 
+
+
+#ifndef _ROLLUP_H
+#define _ROLLUP_H
+
+
+#include <stdint.h>
+#include <stdbool.h>
+
+
+// each tier is a whole number of the one below it. A month is 30 days of uptime, not a calendar month.
+enum ROLLUP_TIER
+{
+	ROLLUP_SECOND,
+	ROLLUP_MINUTE,
+	ROLLUP_HOUR,
+	ROLLUP_DAY,
+	ROLLUP_MONTH,
+	ROLLUP_TIERS
+};
+
+// bit in the value returned by rollup_ticks() for a tier
+#define ROLLUP_TICK(tier) (1 << (tier))
+
+// most channels that can be registered
+#define MAX_ROLLUP 2
+
+typedef struct rollup_stats
+{
+	int32_t sum;
+	int16_t min;
+	int16_t max;
+	uint16_t count;
+} ROLLUP_STATS;
+
+typedef struct rollup_channel
+{
+	ROLLUP_STATS now[ROLLUP_TIERS];		// the period in progress
+	ROLLUP_STATS last[ROLLUP_TIERS];		// the last complete period
+} ROLLUP;
+
+void rollup_register (ROLLUP * R);
+void run_rollup (void);
+uint8_t rollup_ticks (void);
+void rollup_add (ROLLUP * R, int16_t value);
+const ROLLUP_STATS *rollup_now (ROLLUP * R, enum ROLLUP_TIER tier);
+const ROLLUP_STATS *rollup_last (ROLLUP * R, enum ROLLUP_TIER tier);
+int16_t rollup_mean (const ROLLUP_STATS * S);
+
+#endif
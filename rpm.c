@@ -31,6 +31,7 @@
 #include "features.h"
 #include "median.h"
 #include "minmax.h"
+#include "rollup.h"
 #include "rtc.h"
 #include "eeprommap.h"
 #include "rpm.h"
@@ -76,7 +77,6 @@ void
 run_rpm (void)
 {
 	uint16_t value;
-	static uint32_t lastmin = 0;
 
 
 	if (gPeriod)
@@ -97,9 +97,8 @@ run_rpm (void)
 		gRPM = 0;
 
 	// see if a minute has passed, if so advance the pointer to track the last hour
-	if (uptime() >= lastmin + 60)
+	if (rollup_ticks() & ROLLUP_TICK(ROLLUP_MINUTE))
 	{
-		lastmin = uptime();
 		minmax_add(&RpmHourMax);
 	}
 
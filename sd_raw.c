@@ -60,6 +60,8 @@
 #define CMD_READ_SINGLE_BLOCK 0x11
 /* CMD18: arg0[31:0]: data address, response R1 */
 #define CMD_READ_MULTIPLE_BLOCK 0x12
+/* ACMD23: arg0[22:0]: number of blocks to pre-erase, response R1 */
+#define CMD_SD_SET_WR_BLK_ERASE_COUNT 0x17
 /* CMD24: arg0[31:0]: data address, response R1 */
 #define CMD_WRITE_SINGLE_BLOCK 0x18
 /* CMD25: arg0[31:0]: data address, response R1 */
@@ -145,13 +147,15 @@
 #define SD_RAW_SPEC_SDHC 2
 
 #if !SD_RAW_SAVE_RAM
-/* static data buffer for acceleration */
-static uint8_t raw_block[512];
-/* offset where the data within raw_block lies on the card */
-static offset_t raw_block_address;
+/* static data buffers for acceleration */
+static uint8_t raw_block[SD_RAW_CACHE_BLOCKS][512];
+/* offsets where the data within raw_block lies on the card */
+static offset_t raw_block_address[SD_RAW_CACHE_BLOCKS];
+/* cache entries ordered from most to least recently used */
+static uint8_t raw_block_lru[SD_RAW_CACHE_BLOCKS];
 #if SD_RAW_WRITE_BUFFERING
-/* flag to remember if raw_block was written to the card */
-static uint8_t raw_block_written;
+/* flags to remember if raw_block was written to the card */
+static uint8_t raw_block_written[SD_RAW_CACHE_BLOCKS];
 #endif
 #endif
 
@@ -162,6 +166,13 @@ static uint8_t sd_raw_card_type;
 static void sd_raw_send_byte(uint8_t b);
 static uint8_t sd_raw_rec_byte(void);
 static uint8_t sd_raw_send_command(uint8_t command, uint32_t arg);
+#if !SD_RAW_SAVE_RAM
+static uint8_t sd_raw_read_block(offset_t block_address, uint8_t* buffer);
+static uint8_t sd_raw_cache_get(offset_t block_address, uint8_t fill);
+#endif
+#if SD_RAW_WRITE_SUPPORT
+static uint8_t sd_raw_write_block(offset_t block_address, const uint8_t* buffer);
+#endif
 
 /**
  * \ingroup sd_raw
@@ -183,6 +194,18 @@ uint8_t sd_raw_init()
 
     unselect_card();
 
+#if !SD_RAW_SAVE_RAM
+    /* empty the cache, whatever was not written yet went with the old card */
+    for(uint8_t i = 0; i < SD_RAW_CACHE_BLOCKS; ++i)
+    {
+        raw_block_address[i] = (offset_t) -1;
+        raw_block_lru[i] = i;
+#if SD_RAW_WRITE_BUFFERING
+        raw_block_written[i] = 1;
+#endif
+    }
+#endif
+
     if(!sd_raw_available())
         return 0;
 
@@ -319,11 +342,7 @@ uint8_t sd_raw_init()
 
 #if !SD_RAW_SAVE_RAM
     /* the first block is likely to be accessed first, so precache it here */
-    raw_block_address = (offset_t) -1;
-#if SD_RAW_WRITE_BUFFERING
-    raw_block_written = 1;
-#endif
-    if(!sd_raw_read(0, raw_block, sizeof(raw_block)))
+    if(sd_raw_cache_get(0, 1) >= SD_RAW_CACHE_BLOCKS)
         return 0;
 #endif
 
@@ -453,75 +472,236 @@ uint8_t sd_raw_read(offset_t offset, uint8_t* buffer, uintptr_t length)
         if(read_length > length)
             read_length = length;
         
-#if !SD_RAW_SAVE_RAM
-        /* check if the requested data is cached */
-        if(block_address != raw_block_address)
+#if SD_RAW_SAVE_RAM
+        /* address card */
+        select_card();
+
+        /* send single block request */
+#if SD_RAW_SDHC
+        if(sd_raw_send_command(CMD_READ_SINGLE_BLOCK, (sd_raw_card_type & (1 << SD_RAW_SPEC_SDHC) ? block_address / 512 : block_address)))
+#else
+        if(sd_raw_send_command(CMD_READ_SINGLE_BLOCK, block_address))
 #endif
         {
+            unselect_card();
+            return 0;
+        }
+
+        /* wait for data block (start byte 0xfe) */
+        while(sd_raw_rec_byte() != 0xfe);
+
+        /* read byte block */
+        uint16_t read_to = block_offset + read_length;
+        for(uint16_t i = 0; i < 512; ++i)
+        {
+            uint8_t b = sd_raw_rec_byte();
+            if(i >= block_offset && i < read_to)
+                *buffer++ = b;
+        }
+        
+        /* read crc16 */
+        sd_raw_rec_byte();
+        sd_raw_rec_byte();
+        
+        /* deaddress card */
+        unselect_card();
+
+        /* let card some time to finish */
+        sd_raw_rec_byte();
+#else
+        /* fetch the block through the cache */
+        uint8_t slot = sd_raw_cache_get(block_address, 1);
+        if(slot >= SD_RAW_CACHE_BLOCKS)
+            return 0;
+
+        memcpy(buffer, raw_block[slot] + block_offset, read_length);
+        buffer += read_length;
+#endif
+
+        length -= read_length;
+        offset += read_length;
+    }
+
+    return 1;
+}
+
+#if DOXYGEN || !SD_RAW_SAVE_RAM
+/**
+ * \ingroup sd_raw
+ * Reads a single block from the card, bypassing the cache.
+ *
+ * \param[in] block_address The offset of the block on the card.
+ * \param[out] buffer The buffer into which to write the 512 bytes of the block.
+ * \returns 0 on failure, 1 on success.
+ */
+uint8_t sd_raw_read_block(offset_t block_address, uint8_t* buffer)
+{
+    /* address card */
+    select_card();
+
+    /* send single block request */
+#if SD_RAW_SDHC
+    if(sd_raw_send_command(CMD_READ_SINGLE_BLOCK, (sd_raw_card_type & (1 << SD_RAW_SPEC_SDHC) ? block_address / 512 : block_address)))
+#else
+    if(sd_raw_send_command(CMD_READ_SINGLE_BLOCK, block_address))
+#endif
+    {
+        unselect_card();
+        return 0;
+    }
+
+    /* wait for data block (start byte 0xfe) */
+    while(sd_raw_rec_byte() != 0xfe);
+
+    /* read byte block */
+    for(uint16_t i = 0; i < 512; ++i)
+        *buffer++ = sd_raw_rec_byte();
+
+    /* read crc16 */
+    sd_raw_rec_byte();
+    sd_raw_rec_byte();
+
+    /* deaddress card */
+    unselect_card();
+
+    /* let card some time to finish */
+    sd_raw_rec_byte();
+
+    return 1;
+}
+
+/**
+ * \ingroup sd_raw
+ * Looks up a block in the cache and marks it as the most recently used one.
+ *
+ * On a miss, the least recently used entry is written back if it is
+ * dirty and then reused for the requested block.
+ *
+ * \param[in] block_address The offset of the block on the card.
+ * \param[in] fill Whether to read the block from the card on a miss. Pass 0 if the whole block gets overwritten anyway.
+ * \returns The index of the cache entry holding the block, \c SD_RAW_CACHE_BLOCKS on failure.
+ */
+uint8_t sd_raw_cache_get(offset_t block_address, uint8_t fill)
+{
+    /* find the block, falling back to the least recently used entry */
+    uint8_t i;
+    for(i = 0; i < SD_RAW_CACHE_BLOCKS - 1; ++i)
+    {
+        if(raw_block_address[raw_block_lru[i]] == block_address)
+            break;
+    }
+    uint8_t slot = raw_block_lru[i];
+
+    if(raw_block_address[slot] != block_address)
+    {
 #if SD_RAW_WRITE_BUFFERING
-            if(!sd_raw_sync())
-                return 0;
+        if(!raw_block_written[slot])
+        {
+            if(!sd_raw_write_block(raw_block_address[slot], raw_block[slot]))
+                return SD_RAW_CACHE_BLOCKS;
+            raw_block_written[slot] = 1;
+        }
+#endif
+
+        raw_block_address[slot] = (offset_t) -1;
+        if(fill && !sd_raw_read_block(block_address, raw_block[slot]))
+            return SD_RAW_CACHE_BLOCKS;
+        raw_block_address[slot] = block_address;
+    }
+
+    /* move the entry to the front */
+    for(; i > 0; --i)
+        raw_block_lru[i] = raw_block_lru[i - 1];
+    raw_block_lru[0] = slot;
+
+    return slot;
+}
 #endif
 
-            /* address card */
-            select_card();
+/**
+ * \ingroup sd_raw
+ * Reads whole blocks from the card using a single multiple block command.
+ *
+ * Compared to sd_raw_read(), the command and the access latency of the
+ * card are paid only once for all the blocks instead of once per block.
+ * The data goes straight into \c buffer, only blocks which are cached
+ * but not yet written to the card are taken from the cache. A single
+ * block is read on its own the same way, so reading through a file
+ * doesn't push the FAT and directory sectors out of the cache.
+ *
+ * \param[in] offset The offset of the first block to read, must lie on a block border.
+ * \param[out] buffer The buffer into which to write the data, \c count * 512 bytes in size.
+ * \param[in] count The number of blocks to read.
+ * \returns 0 on failure, 1 on success.
+ * \see sd_raw_read, sd_raw_write_blocks
+ */
+uint8_t sd_raw_read_blocks(offset_t offset, uint8_t* buffer, uint16_t count)
+{
+    if(offset & 0x01ff)
+        return 0;
+    if(count == 0)
+        return 1;
+    if(count == 1)
+    {
+#if !SD_RAW_SAVE_RAM
+        if(!sd_raw_read_block(offset, buffer))
+            return 0;
+#else
+        return sd_raw_read(offset, buffer, 512);
+#endif
+    }
+    else
+    {
+        /* address card */
+        select_card();
 
-            /* send single block request */
+        /* send multiple block request */
 #if SD_RAW_SDHC
-            if(sd_raw_send_command(CMD_READ_SINGLE_BLOCK, (sd_raw_card_type & (1 << SD_RAW_SPEC_SDHC) ? block_address / 512 : block_address)))
+        if(sd_raw_send_command(CMD_READ_MULTIPLE_BLOCK, (sd_raw_card_type & (1 << SD_RAW_SPEC_SDHC) ? offset / 512 : offset)))
 #else
-            if(sd_raw_send_command(CMD_READ_SINGLE_BLOCK, block_address))
+        if(sd_raw_send_command(CMD_READ_MULTIPLE_BLOCK, offset))
 #endif
-            {
-                unselect_card();
-                return 0;
-            }
+        {
+            unselect_card();
+            return 0;
+        }
 
+        uint8_t* data = buffer;
+        for(uint16_t n = 0; n < count; ++n)
+        {
             /* wait for data block (start byte 0xfe) */
             while(sd_raw_rec_byte() != 0xfe);
 
-#if SD_RAW_SAVE_RAM
             /* read byte block */
-            uint16_t read_to = block_offset + read_length;
             for(uint16_t i = 0; i < 512; ++i)
-            {
-                uint8_t b = sd_raw_rec_byte();
-                if(i >= block_offset && i < read_to)
-                    *buffer++ = b;
-            }
-#else
-            /* read byte block */
-            uint8_t* cache = raw_block;
-            for(uint16_t i = 0; i < 512; ++i)
-                *cache++ = sd_raw_rec_byte();
-            raw_block_address = block_address;
+                *data++ = sd_raw_rec_byte();
 
-            memcpy(buffer, raw_block + block_offset, read_length);
-            buffer += read_length;
-#endif
-            
             /* read crc16 */
             sd_raw_rec_byte();
             sd_raw_rec_byte();
-            
-            /* deaddress card */
-            unselect_card();
-
-            /* let card some time to finish */
-            sd_raw_rec_byte();
         }
-#if !SD_RAW_SAVE_RAM
-        else
-        {
-            /* use cached data */
-            memcpy(buffer, raw_block + block_offset, read_length);
-            buffer += read_length;
-        }
-#endif
 
-        length -= read_length;
-        offset += read_length;
+        /* stop the transfer and wait while the card is busy */
+        sd_raw_send_command(CMD_STOP_TRANSMISSION, 0);
+        while(sd_raw_rec_byte() != 0xff);
+
+        /* deaddress card */
+        unselect_card();
+
+        /* let card some time to finish */
+        sd_raw_rec_byte();
+    }
+
+#if SD_RAW_WRITE_BUFFERING
+    /* the card still has the old content of blocks waiting to be written */
+    for(uint8_t i = 0; i < SD_RAW_CACHE_BLOCKS; ++i)
+    {
+        if(raw_block_written[i] || raw_block_address[i] < offset || raw_block_address[i] >= offset + (offset_t) count * 512)
+            continue;
+
+        memcpy(buffer + (uintptr_t) (raw_block_address[i] - offset), raw_block[i], 512);
     }
+#endif
 
     return 1;
 }
@@ -681,76 +861,184 @@ uint8_t sd_raw_write(offset_t offset, const uint8_t* buffer, uintptr_t length)
             write_length = length;
         
         /* Merge the data to write with the content of the block.
-         * Use the cached block if available.
+         * The block only has to be read if it is not overwritten entirely.
          */
-        if(block_address != raw_block_address)
-        {
+        uint8_t slot = sd_raw_cache_get(block_address, block_offset || write_length < 512);
+        if(slot >= SD_RAW_CACHE_BLOCKS)
+            return 0;
+
+        memcpy(raw_block[slot] + block_offset, buffer, write_length);
+
 #if SD_RAW_WRITE_BUFFERING
-            if(!sd_raw_sync())
-                return 0;
+        /* leave it to sd_raw_sync() or the eviction of the entry */
+        raw_block_written[slot] = 0;
+#else
+        if(!sd_raw_write_block(block_address, raw_block[slot]))
+        {
+            /* the cached data does not match the card any more */
+            raw_block_address[slot] = (offset_t) -1;
+            return 0;
+        }
 #endif
 
-            if(block_offset || write_length < 512)
-            {
-                if(!sd_raw_read(block_address, raw_block, sizeof(raw_block)))
-                    return 0;
-            }
-            raw_block_address = block_address;
-        }
+        buffer += write_length;
+        offset += write_length;
+        length -= write_length;
+    }
 
-        if(buffer != raw_block)
-        {
-            memcpy(raw_block + block_offset, buffer, write_length);
+    return 1;
+}
 
-#if SD_RAW_WRITE_BUFFERING
-            raw_block_written = 0;
+/**
+ * \ingroup sd_raw
+ * Writes a single block to the card, bypassing the cache.
+ *
+ * \param[in] block_address The offset of the block on the card.
+ * \param[in] buffer The 512 bytes to write.
+ * \returns 0 on failure, 1 on success.
+ */
+uint8_t sd_raw_write_block(offset_t block_address, const uint8_t* buffer)
+{
+    /* address card */
+    select_card();
 
-            if(length == write_length)
-                return 1;
+    /* send single block request */
+#if SD_RAW_SDHC
+    if(sd_raw_send_command(CMD_WRITE_SINGLE_BLOCK, (sd_raw_card_type & (1 << SD_RAW_SPEC_SDHC) ? block_address / 512 : block_address)))
+#else
+    if(sd_raw_send_command(CMD_WRITE_SINGLE_BLOCK, block_address))
 #endif
-        }
+    {
+        unselect_card();
+        return 0;
+    }
 
-        /* address card */
-        select_card();
+    /* send start byte */
+    sd_raw_send_byte(0xfe);
 
-        /* send single block request */
+    /* write byte block */
+    for(uint16_t i = 0; i < 512; ++i)
+        sd_raw_send_byte(*buffer++);
+
+    /* write dummy crc16 */
+    sd_raw_send_byte(0xff);
+    sd_raw_send_byte(0xff);
+
+    /* wait while card is busy */
+    while(sd_raw_rec_byte() != 0xff);
+    sd_raw_rec_byte();
+
+    /* deaddress card */
+    unselect_card();
+
+    return 1;
+}
+#endif
+
+#if DOXYGEN || SD_RAW_WRITE_SUPPORT
+/**
+ * \ingroup sd_raw
+ * Writes whole blocks to the card using a single multiple block command.
+ *
+ * Compared to sd_raw_write(), the command is sent only once for all the
+ * blocks and no block is read back first. When SD_RAW_WRITE_PRE_ERASE is
+ * set, SD cards are told the number of blocks in advance so that they can
+ * erase them all at once.
+ *
+ * \note If the block cache holds one of the blocks written, it is updated
+ *       to the new data.
+ *
+ * \param[in] offset The offset of the first block to write, must lie on a block border.
+ * \param[in] buffer The buffer containing the data to be written, \c count * 512 bytes in size.
+ * \param[in] count The number of blocks to write.
+ * \returns 0 on failure, 1 on success.
+ * \see sd_raw_write, sd_raw_read_blocks
+ */
+uint8_t sd_raw_write_blocks(offset_t offset, const uint8_t* buffer, uint16_t count)
+{
+    if(offset & 0x01ff)
+        return 0;
+    if(count < 2)
+        return sd_raw_write(offset, buffer, (uintptr_t) count * 512);
+    if(sd_raw_locked())
+        return 0;
+
+    const uint8_t* data = buffer;
+    uint8_t response = DR_STATUS_ACCEPTED;
+
+    /* address card */
+    select_card();
+
+#if SD_RAW_WRITE_PRE_ERASE
+    /* MMC cards do not know about pre-erasing */
+    if(sd_raw_card_type & ((1 << SD_RAW_SPEC_1) | (1 << SD_RAW_SPEC_2)))
+    {
+        sd_raw_send_command(CMD_APP, 0);
+        sd_raw_send_command(CMD_SD_SET_WR_BLK_ERASE_COUNT, count);
+    }
+#endif
+
+    /* send multiple block request */
 #if SD_RAW_SDHC
-        if(sd_raw_send_command(CMD_WRITE_SINGLE_BLOCK, (sd_raw_card_type & (1 << SD_RAW_SPEC_SDHC) ? block_address / 512 : block_address)))
+    if(sd_raw_send_command(CMD_WRITE_MULTIPLE_BLOCK, (sd_raw_card_type & (1 << SD_RAW_SPEC_SDHC) ? offset / 512 : offset)))
 #else
-        if(sd_raw_send_command(CMD_WRITE_SINGLE_BLOCK, block_address))
+    if(sd_raw_send_command(CMD_WRITE_MULTIPLE_BLOCK, offset))
 #endif
-        {
-            unselect_card();
-            return 0;
-        }
+    {
+        unselect_card();
+        return 0;
+    }
 
+    for(uint16_t n = 0; n < count; ++n)
+    {
         /* send start byte */
-        sd_raw_send_byte(0xfe);
+        sd_raw_send_byte(0xfc);
 
         /* write byte block */
-        uint8_t* cache = raw_block;
         for(uint16_t i = 0; i < 512; ++i)
-            sd_raw_send_byte(*cache++);
+            sd_raw_send_byte(*data++);
 
         /* write dummy crc16 */
         sd_raw_send_byte(0xff);
         sd_raw_send_byte(0xff);
 
+        /* check the data response, the card stops accepting blocks after an error */
+        response = sd_raw_rec_byte() & 0x1f;
+
         /* wait while card is busy */
         while(sd_raw_rec_byte() != 0xff);
-        sd_raw_rec_byte();
 
-        /* deaddress card */
-        unselect_card();
+        if(response != DR_STATUS_ACCEPTED)
+            break;
+    }
 
-        buffer += write_length;
-        offset += write_length;
-        length -= write_length;
+    /* send stop byte and wait while card is busy */
+    sd_raw_send_byte(0xfd);
+    sd_raw_rec_byte();
+    while(sd_raw_rec_byte() != 0xff);
+
+    /* deaddress card */
+    unselect_card();
+
+    /* let card some time to finish */
+    sd_raw_rec_byte();
+
+    if(response != DR_STATUS_ACCEPTED)
+        return 0;
+
+#if !SD_RAW_SAVE_RAM
+    /* keep the cached blocks in line with the card */
+    for(uint8_t i = 0; i < SD_RAW_CACHE_BLOCKS; ++i)
+    {
+        if(raw_block_address[i] < offset || raw_block_address[i] >= offset + (offset_t) count * 512)
+            continue;
 
+        memcpy(raw_block[i], buffer + (uintptr_t) (raw_block_address[i] - offset), 512);
 #if SD_RAW_WRITE_BUFFERING
-        raw_block_written = 1;
+        raw_block_written[i] = 1;
 #endif
     }
+#endif
 
     return 1;
 }
@@ -823,11 +1111,14 @@ uint8_t sd_raw_write_interval(offset_t offset, uint8_t* buffer, uintptr_t length
 uint8_t sd_raw_sync()
 {
 #if SD_RAW_WRITE_BUFFERING
-    if(raw_block_written)
-        return 1;
-    if(!sd_raw_write(raw_block_address, raw_block, sizeof(raw_block)))
-        return 0;
-    raw_block_written = 1;
+    for(uint8_t i = 0; i < SD_RAW_CACHE_BLOCKS; ++i)
+    {
+        if(raw_block_written[i])
+            continue;
+        if(!sd_raw_write_block(raw_block_address[i], raw_block[i]))
+            return 0;
+        raw_block_written[i] = 1;
+    }
 #endif
     return 1;
 }
@@ -46,7 +46,31 @@ extern "C"
  *
  * \note This option has no effect when SD_RAW_WRITE_SUPPORT is 0.
  */
-#define SD_RAW_WRITE_BUFFERING 0
+#define SD_RAW_WRITE_BUFFERING 1
+
+/**
+ * \ingroup sd_raw_config
+ * The number of blocks kept in the block cache.
+ *
+ * Each one costs 512 bytes of RAM, which the ATmega2560's 8k can't
+ * spare much of. Two keep the FAT or directory sector and the data
+ * sector of a file being appended to resident at the same time, the
+ * logger keeps its partial sector in its own buffer anyway.
+ *
+ * \note This option has no effect when SD_RAW_SAVE_RAM is 1.
+ */
+#define SD_RAW_CACHE_BLOCKS 2
+
+/**
+ * \ingroup sd_raw_config
+ * Controls pre-erasing for multiple block writes.
+ *
+ * Set to 1 to tell SD cards how many blocks sd_raw_write_blocks() is
+ * about to write, which lets the card erase them in one go.
+ *
+ * \note This option has no effect when SD_RAW_WRITE_SUPPORT is 0.
+ */
+#define SD_RAW_WRITE_PRE_ERASE 1
 
 /**
  * \ingroup sd_raw_config
@@ -115,6 +139,8 @@ extern "C"
     #define configure_pin_miso() DDRB &= ~(1 << DDB3)
     #define select_card() PORTB &= ~(1 << PORTB0)
     #define unselect_card() PORTB |= (1 << PORTB0)
+#elif !defined(__AVR__)
+    /* host builds of the FAT code (tools/host) don't drive a card */
 #else
     #error "no sd/mmc pin mapping available!"
 #endif
@@ -33,6 +33,7 @@
 
 #include <drv/ser.h>
 #include <drv/timer.h>
+#include <cpu/irq.h>
 #include <cfg/log.h>
 #include <drv/lcd_hd44.h>
 
@@ -57,6 +58,36 @@ extern Serial serial;
 bool sd_ok = true;
 bool gLive = true;
 
+// filesystem session kept open between log records
+static struct partition_struct *partition = NULL;
+static struct fat_fs_struct *fs = NULL;
+static struct fat_dir_struct *dd = NULL;
+// the current day's log file
+static struct fat_file_struct *logfd = NULL;
+static char logname[20];
+
+// the last (partial) sector of the log file. Records are gathered here and only written to the card when
+// the sector is full or the oldest unwritten data is LOG_FLUSH_AGE seconds old. The file position is kept
+// at the start of this sector.
+#define LOG_SECTOR 512
+static uint8_t log_sector[LOG_SECTOR];
+static uint16_t log_fill = 0;			  // bytes used in log_sector
+static uint32_t log_sector_pos;		  // file offset of log_sector
+static bool log_dirty = false;		  // log_sector has data not yet on the card
+static uint32_t log_since;			  // uptime when it became dirty
+
+// records waiting to be written, filled by log_event and emptied a bit at a time by run_log
+static LOG_RECORD log_queue[LOG_QUEUE_SIZE];
+static uint8_t log_head = 0;			  // next free slot
+static uint8_t log_count = 0;			  // number of records waiting
+uint16_t gLogDropped = 0;			  // records lost because the queue was full
+uint8_t gLogPeak = 0;				  // most records ever waiting
+
+// files are dumped a whole sector at a time through log_sector, which is free once the log has been
+// flushed, rather than reading the card for every record or line
+static uint16_t dump_len;				  // bytes in log_sector
+static uint16_t dump_pos;				  // next byte to hand out
+
 enum FILEACTIONS
 {
 	FA_RM = 1,
@@ -67,6 +98,22 @@ enum FILEACTIONS
 	FA_FIND,
 };
 
+static void fs_unmount (void);
+static void dump_file (struct fat_file_struct *fd, const char *filename, const char *data);
+
+// make a new log file name each day - now allows long filenames!!
+#if LOG_BINARY
+#define LOG_NAME "log-%02d%02d%02d.bin"
+#else
+#define LOG_NAME "log-%02d%02d%02d.txt"
+#endif
+
+// space reserved as one contiguous run when a day's log file is created. Text lines are about 125 bytes.
+#if LOG_BINARY
+#define LOG_PREALLOC ((uint32_t) LOG_RECORDS_PER_DAY * sizeof (LOG_RECORD) + sizeof (LOG_HEADER))
+#else
+#define LOG_PREALLOC ((uint32_t) LOG_RECORDS_PER_DAY * 128)
+#endif
 
 
 
@@ -74,6 +121,9 @@ enum FILEACTIONS
 void
 log_init (void)
 {
+	// anything we had open belonged to the last card (or the last attempt at this one)
+	fs_unmount ();
+
 	if (!sd_raw_available ())
 	{
 		LOG_INFO ("No SD Card plugged in\n");
@@ -89,29 +139,59 @@ log_init (void)
 
 }
 
-// formats the data from a binary log record struct into a printable buffer
+// take a copy of everything that goes into a log record so that it can be written out later
 static void
-format_record (uint8_t event, char *buffer)
+log_snapshot (uint8_t event, LOG_RECORD * rec)
 {
-	float power;
-	uint8_t flags = event, month, day;
-
-	get_month_day(&month, &day);
+	uint8_t flags = event;
 
 	if (gLoad != LOADOFF)
 		flags |= LOG_LOAD;
 	if (gDump > 0)
 		flags |= LOG_SHUNT;
 
-	sprintf (buffer, "%02d-%02d-%02d %02d:%02d:%02d ", day, month, gYEAR, gHOUR, gMINUTE, gSECOND);
+	rec->day = gDAY;
+	rec->month = gMONTH;
+	rec->year = gYEAR;
+	rec->hour = gHOUR;
+	rec->minute = gMINUTE;
+	rec->second = gSECOND;
+	rec->flags = flags;
+	rec->dump = gDump;
+	rec->volts = gVolts;
+	rec->amps = gAmps;
+	rec->charge = gCharge;
+	rec->temp = gTemp;
+	rec->rpm = gRPM;
+	rec->maxrpm = gMaxRPM;
+	rec->maxhour = gMaxhour;
+	rec->maxday = gMaxday;
+	rec->minhour = gMinhour;
+	rec->minday = gMinday;
+	rec->cca = gCCA;
+	rec->dca = gDCA;
+}
+
+// formats the data from a binary log record struct into a printable buffer
+static void
+format_record (const LOG_RECORD * rec, char *buffer)
+{
+	float power;
+	uint8_t flags = rec->flags;
+
+	if (gUSdate)
+		sprintf (buffer, "%02d-%02d-%02d ", rec->month, rec->day, rec->year);
+	else
+		sprintf (buffer, "%02d-%02d-%02d ", rec->day, rec->month, rec->year);
+	sprintf (buffer + strlen (buffer), "%02d:%02d:%02d ", rec->hour, rec->minute, rec->second);
 	sprintf (buffer + strlen (buffer), "E:%c L:%c S:%c F:%d ", flags & LOG_ERROR ? '1' : '0', flags & LOG_LOAD ? '1' : '0', flags & LOG_SHUNT ? '1' : '0', flags & LOG_MASK_VALUE);
 
-	sprintf (buffer + strlen (buffer), "D:%d T:%.*s%d.%02u C:%u ", gDump, gTemp < 0 ? 1 : 0, "-", abs (gTemp / 100), abs (gTemp % 100), gCharge);
-	sprintf (buffer + strlen (buffer), "V:%d.%02u A:%.*s%d.%02u ", gVolts / 100, gVolts % 100, gAmps < 0 ? 1 : 0, "-", abs (gAmps / 100), abs (gAmps % 100));
+	sprintf (buffer + strlen (buffer), "D:%d T:%.*s%d.%02u C:%u ", rec->dump, rec->temp < 0 ? 1 : 0, "-", abs (rec->temp / 100), abs (rec->temp % 100), rec->charge);
+	sprintf (buffer + strlen (buffer), "V:%d.%02u A:%.*s%d.%02u ", rec->volts / 100, rec->volts % 100, rec->amps < 0 ? 1 : 0, "-", abs (rec->amps / 100), abs (rec->amps % 100));
 
 	// volts & amps are scaled by 100 each so loose 10,000
-	power = ((float) gAmps * (float) gVolts) / 10000.0;
-	sprintf (buffer + strlen (buffer), "P:%d R:%d r:%d H:%d Y:%d h:%d y:%d I:%u O:%u\r\n", (int16_t) power, gRPM, gMaxRPM, gMaxhour, gMaxday, gMinhour, gMinday, (uint16_t)gCCA, (uint16_t)gDCA);
+	power = ((float) rec->amps * (float) rec->volts) / 10000.0;
+	sprintf (buffer + strlen (buffer), "P:%d R:%d r:%d H:%d Y:%d h:%d y:%d I:%u O:%u\r\n", (int16_t) power, rec->rpm, rec->maxrpm, rec->maxhour, rec->maxday, rec->minhour, rec->minday, rec->cca, rec->dca);
 	return;
 }
 
@@ -144,7 +224,7 @@ open_file_in_dir (struct fat_fs_struct *fs, struct fat_dir_struct *dd, const cha
 
 // all you wanted to know about the SD card
 static uint8_t
-print_disk_info (const struct fat_fs_struct *fs)
+print_disk_info (struct fat_fs_struct *fs)
 {
 	if (!fs)
 		return 0;
@@ -168,20 +248,146 @@ print_disk_info (const struct fat_fs_struct *fs)
 	return 1;
 }
 
-// take one of several actions on a file or the whole filesystem. Done in one lump as there is a lot of common
-// code to open the partition and root directory for all actions.
+// write the sector buffer to the card. A full sector moves the buffer on to the next one, a partial one is
+// written again from the same place when it next gets flushed.
+static bool
+log_flush (void)
+{
+	if ((!logfd) || (!log_dirty))
+		return true;
+
+	if (fat_write_file (logfd, log_sector, log_fill) != log_fill)
+	{
+		LOG_WARN ("error writing to file %s\n", logname);
+		log_dirty = false;			  // it's lost, don't try again on the way down
+		return false;
+	}
+
+	if (log_fill == LOG_SECTOR)
+	{
+		log_sector_pos += LOG_SECTOR;
+		log_fill = 0;
+	}
+	else
+	{
+		int32_t offset = -(int32_t) log_fill;
+		if (!fat_seek_file (logfd, &offset, FAT_SEEK_CUR))
+		{
+			log_dirty = false;
+			return false;
+		}
+	}
+	log_dirty = false;
+
+	// keep the file size on the card up to date in case the card is pulled or we lose power
+	if (!fat_sync_file (logfd))
+		LOG_WARN ("error updating %s\n", logname);
+	if (!sd_raw_sync ())
+		LOG_WARN ("error syncing disk\n");
+
+	return true;
+}
+
+// add data to the end of the log, writing out each sector as it fills
+static bool
+log_append (const uint8_t * data, uint8_t len)
+{
+	while (len > 0)
+	{
+		uint16_t n = LOG_SECTOR - log_fill;
+		if (n > len)
+			n = len;
+
+		memcpy (log_sector + log_fill, data, n);
+		log_fill += n;
+		data += n;
+		len -= n;
+
+		if (!log_dirty)
+		{
+			log_dirty = true;
+			log_since = uptime ();
+		}
+
+		if ((log_fill == LOG_SECTOR) && (!log_flush ()))
+			return false;
+	}
+	return true;
+}
+
+// read what there is of the log file's last sector into log_sector, leaving the file position at its start
+static bool
+log_load_sector (struct fat_file_struct *fd)
+{
+	int32_t offset = log_sector_pos;
+
+	if (log_fill == 0)
+		return true;
+
+	return fat_seek_file (fd, &offset, FAT_SEEK_SET) && (fat_read_file (fd, log_sector, log_fill) == log_fill) &&
+		fat_seek_file (fd, &offset, FAT_SEEK_SET);
+}
+
+// close the current day's log file, bringing its directory entry up to date and giving back any of
+// the preallocated space that wasn't used
+static void
+log_close_file (void)
+{
+	if (logfd)
+	{
+		if (log_flush ())
+			fat_resize_file (logfd, log_sector_pos + log_fill);
+		fat_close_file (logfd);
+		logfd = NULL;
+		if (!sd_raw_sync ())
+			LOG_WARN ("error syncing disk\n");
+	}
+	logname[0] = '\0';
+	log_fill = 0;
+	log_dirty = false;
+}
+
+// tear down the whole filesystem session. Only needed when the card has gone or failed.
 static void
-file_action (char *filename, enum FILEACTIONS action, char *data)
+fs_unmount (void)
 {
+	log_close_file ();
+
+	if (dd)
+	{
+		fat_close_dir (dd);
+		dd = NULL;
+	}
+	if (fs)
+	{
+		fat_close (fs);				  // updates the FSInfo sector
+		fs = NULL;
+		sd_raw_sync ();
+	}
+	if (partition)
+	{
+		partition_close (partition);
+		partition = NULL;
+	}
+}
 
+// make sure the partition, filesystem and root directory are open. They stay open between calls
+// so that logging a record doesn't have to remount the card every time.
+static bool
+fs_mount (void)
+{
 	if ((!sd_ok) || (!sd_raw_available ()))
 	{
+		fs_unmount ();
 		sd_ok = false;				  // if card removed, force a re-init
-		return;
+		return false;
 	}
 
+	if (dd)
+		return true;				  // already mounted
+
 	/* open first partition */
-	struct partition_struct *partition = partition_open (sd_raw_read, sd_raw_read_interval, sd_raw_write, sd_raw_write_interval, 0);
+	partition = partition_open (sd_raw_read, sd_raw_read_interval, sd_raw_write, sd_raw_write_interval, 0);
 
 	if (!partition)
 	{
@@ -193,78 +399,193 @@ file_action (char *filename, enum FILEACTIONS action, char *data)
 		{
 			LOG_WARN ("opening partition failed\n");
 			sd_ok = false;
-			return;
+			return false;
 		}
 	}
 
+	// let whole blocks of a file go over in one multiple block transfer
+	partition->device_read_blocks = sd_raw_read_blocks;
+	partition->device_write_blocks = sd_raw_write_blocks;
+
 	/* open file system */
-	struct fat_fs_struct *fs = fat_open (partition);
+	fs = fat_open (partition);
 	if (!fs)
 	{
 		LOG_WARN ("opening filesystem failed\n");
-		partition_close (partition);
+		fs_unmount ();
 		sd_ok = false;
-		return;
+		return false;
 	}
 
 	/* open root directory */
 	struct fat_dir_entry_struct directory;
 	fat_get_dir_entry_of_path (fs, "/", &directory);
 
-	struct fat_dir_struct *dd = fat_open_dir (fs, &directory);
+	dd = fat_open_dir (fs, &directory);
 	if (!dd)
 	{
 		LOG_WARN ("opening root directory failed\n");
-		fat_close (fs);
-		partition_close (partition);
+		fs_unmount ();
 		sd_ok = false;
+		return false;
+	}
+
+	return true;
+}
+
+// a log file only gives back its unused preallocation when the day rolls over with it open, so if the unit
+// was off across midnight the last one written before today still has most of a day reserved. They are all
+// named the same way, so that's the latest log older than today's: set its size again to have the rest freed.
+// If it was closed off properly this just goes through its cluster chain to no effect.
+static void
+log_trim_stale (const char *filename)
+{
+	struct fat_dir_entry_struct dir_entry, stale;
+	const char *ext = strrchr (filename, '.');
+
+	if (!ext)
 		return;
+
+	stale.long_name[0] = '\0';
+	while (fat_read_dir (dd, &dir_entry))
+	{
+		if ((strlen (dir_entry.long_name) == strlen (filename)) && (strncmp (dir_entry.long_name, filename, 4) == 0) &&
+			 (strcmp (dir_entry.long_name + (ext - filename), ext) == 0) && (strcmp (dir_entry.long_name, filename) < 0) &&
+			 (strcmp (dir_entry.long_name, stale.long_name) > 0))
+			stale = dir_entry;
 	}
 
-	switch (action)
+	if (stale.long_name[0] == '\0')
+		return;
+
+	struct fat_file_struct *fd = fat_open_file (fs, &stale);
+	if (!fd)
+		return;
+
+	if (!fat_resize_file (fd, stale.file_size))
+		LOG_WARN ("error trimming %s\n", stale.long_name);
+	fat_close_file (fd);
+	if (!sd_raw_sync ())
+		LOG_WARN ("error syncing disk\n");
+}
+
+// get the handle of the log file, opening (or creating) it and loading its last partial sector if it isn't
+// the one already open. A change of name means the day has rolled over so the old file is closed off first.
+static struct fat_file_struct *
+log_open_file (char *filename)
+{
+	if (logfd && (strcmp (logname, filename) == 0))
+		return logfd;
+
+	// if yesterday's file is open closing it gives back its spare space, otherwise look for one left over
+	bool rolled = (logfd != NULL);
+	log_close_file ();
+
+	/* search file in current directory and open it */
+	struct fat_file_struct *fd = open_file_in_dir (fs, dd, filename);
+	if (!fd)
 	{
-	case FA_WRITE:
+		LOG_INFO ("error opening %s - creating\n", filename);
+		struct fat_dir_entry_struct file_entry;
+		if (!fat_create_file (dd, filename, &file_entry))
 		{
-			/* search file in current directory and open it */
-			struct fat_file_struct *fd = open_file_in_dir (fs, dd, filename);
-			if (!fd)
-			{
-				LOG_INFO ("error opening %s - creating\n", filename);
-				struct fat_dir_entry_struct file_entry;
-				if (!fat_create_file (dd, filename, &file_entry))
-				{
-					LOG_WARN ("error creating file: %s\n", filename);
-					return;
-				}
-				fd = open_file_in_dir (fs, dd, filename);
-			}
-// seek to eof
+			LOG_WARN ("error creating file: %s\n", filename);
+			return NULL;
+		}
+		fd = open_file_in_dir (fs, dd, filename);
 
-			/* search file in current directory and open it */
-			if (!fd)
-			{
-				LOG_WARN ("error opening %s\n", filename);
-				return;
-			}
+		if (!rolled)
+			log_trim_stale (filename);
 
-			int32_t offset = 0;
-			if (!fat_seek_file (fd, &offset, FAT_SEEK_END))
-			{
-				LOG_WARN ("error seeking on %s\n", filename);
-				fat_close_file (fd);
+		// reserve the whole day in one run so appending doesn't have to go through the FAT.
+		// If the card is too fragmented the file just grows a cluster at a time.
+		if (fd && (!fat_preallocate_file (fd, LOG_PREALLOC)))
+			LOG_INFO ("no contiguous space for %s\n", filename);
+	}
+
+	if (!fd)
+	{
+		LOG_WARN ("error opening %s\n", filename);
+		return NULL;
+	}
+
+	// seek to eof - only done once per file as the position is kept while the file stays open
+	int32_t offset = 0;
+	if (!fat_seek_file (fd, &offset, FAT_SEEK_END))
+	{
+		LOG_WARN ("error seeking on %s\n", filename);
+		fat_close_file (fd);
+		return NULL;
+	}
+
+	// read in what there is of the last sector and go back to its start
+	log_fill = offset % LOG_SECTOR;
+	log_sector_pos = offset - log_fill;
+	log_dirty = false;
+	if (log_fill)
+	{
+		if (!log_load_sector (fd))
+		{
+			LOG_WARN ("error reading %s\n", filename);
+			fat_close_file (fd);
+			log_fill = 0;
+			return NULL;
+		}
+	}
+
+#if LOG_BINARY
+	// a new binary log needs its header first
+	else if (offset == 0)
+	{
+		LOG_HEADER *header = (LOG_HEADER *) log_sector;
+
+		memset (header, 0, sizeof (LOG_HEADER));
+		memcpy (header->magic, LOG_MAGIC, sizeof (header->magic));
+		header->version = LOG_VERSION;
+		header->header_size = sizeof (LOG_HEADER);
+		header->record_size = sizeof (LOG_RECORD);
+		log_fill = sizeof (LOG_HEADER);
+	}
+#endif
+
+	logfd = fd;
+	strncpy (logname, filename, sizeof (logname) - 1);
+	logname[sizeof (logname) - 1] = '\0';
+	return fd;
+}
+
+// take one of several actions on a file or the whole filesystem. Done in one lump as there is a lot of common
+// code for all actions. The filesystem is left mounted afterwards.
+static void
+file_action (char *filename, enum FILEACTIONS action, char *data, uint8_t data_len)
+{
+
+	if (!fs_mount ())
+		return;
+
+	// anything looking at the files needs to see all of the log
+	if ((action != FA_WRITE) && (!log_flush ()))
+	{
+		fs_unmount ();
+		sd_ok = false;
+		return;
+	}
+
+	switch (action)
+	{
+	case FA_WRITE:
+		{
+			if (!log_open_file (filename))
 				return;
-			}
 
-			uint8_t data_len = strlen (data);
-			/* write text to file */
-			if (fat_write_file (fd, (uint8_t *) data, data_len) != data_len)
+			/* add record to file */
+			if (!log_append ((uint8_t *) data, data_len))
 			{
-				LOG_WARN ("error writing to file %s\n", filename);
+				// drop the whole session and re-init the card, it may have been swapped
+				fs_unmount ();
+				sd_ok = false;
 				return;
 			}
-			fat_close_file (fd);
-			if (!sd_raw_sync ())
-				LOG_WARN ("error syncing disk\n");
 
 			break;
 		}
@@ -273,10 +594,15 @@ file_action (char *filename, enum FILEACTIONS action, char *data)
 			if (strlen (filename) == 0)
 				return;
 
+			// can't delete the file from under the logger
+			if (strcmp (filename, logname) == 0)
+				log_close_file ();
+
 			struct fat_dir_entry_struct file_entry;
 			if (find_file_in_dir (dd, filename, &file_entry))
 			{
-				if (fat_delete_file (fs, &file_entry))
+				// the freed clusters sit in the block cache until synced
+				if (fat_delete_file (fs, &file_entry) && fat_sync (fs) && sd_raw_sync ())
 					return;
 			}
 
@@ -298,11 +624,6 @@ file_action (char *filename, enum FILEACTIONS action, char *data)
 	case FA_CAT:
 	case FA_FIND:
 		{
-			uint8_t buffer[140];
-			int16_t len;
-			char * p;
-			int32_t offset;
-
 			if (strlen (filename) == 0)
 				return;
 
@@ -314,32 +635,15 @@ file_action (char *filename, enum FILEACTIONS action, char *data)
 				return;
 			}
 
-			while ((len = fat_read_file (fd, buffer, sizeof (buffer) - 1)) > 0)
-			{
-				if ((kfile_getc (&serial.fd) & 0x7f) == 0x1b)
-					break;
-
-				buffer[len] = 0;
-				// terminate string at a new line, remember where the newline was
-				if ((p = strchr((const char *)buffer, '\n')))
-					*p++ = 0;
-				// if doing a find then see if the data is present in this line
-				if (data != NULL)
-				{
-					if (strstr((const char *)buffer, data))
-						kfile_printf (&serial.fd, "%s\n", buffer);
-				}
-				else
-					kfile_printf (&serial.fd, "%s\n", buffer);
-
-				// see how much of the buffer we didn't use and seek back that far to get the start of the next line
-				offset = (p - (char *)buffer) - len;
-
-				if(!fat_seek_file(fd, &offset, FAT_SEEK_CUR))
-					break;
+			dump_file (fd, filename, data);
+			fat_close_file (fd);
 
+			// put back the part of the log's last sector the dump wrote over
+			if (logfd && (!log_load_sector (logfd)))
+			{
+				LOG_WARN ("error reading %s\n", logname);
+				log_close_file ();
 			}
-			fat_close_file (fd);
 			break;
 		}
 	case FA_DISK:
@@ -350,42 +654,155 @@ file_action (char *filename, enum FILEACTIONS action, char *data)
 			break;
 		}
 	}
-	/* close directory */
-	fat_close_dir (dd);
 
-	/* close file system */
-	fat_close (fs);
+}
+
+
+// copy the next n bytes of a file being dumped into dst (or just skip them if dst is NULL), refilling
+// log_sector a sector at a time. Returns the number of bytes there were.
+static uint16_t
+dump_read (struct fat_file_struct *fd, uint8_t * dst, uint16_t n)
+{
+	uint16_t got = 0;
+	uint16_t len;
+	intptr_t r;
 
-	/* close partition */
-	partition_close (partition);
+	while (got < n)
+	{
+		if (dump_pos >= dump_len)
+		{
+			// the file position stays a multiple of the sector size so each fill is a whole block
+			r = fat_read_file (fd, log_sector, LOG_SECTOR);
+			if (r <= 0)
+				break;
+			dump_len = r;
+			dump_pos = 0;
+		}
 
+		len = dump_len - dump_pos;
+		if (len > n - got)
+			len = n - got;
+		if (dst)
+			memcpy (dst + got, log_sector + dump_pos, len);
+		dump_pos += len;
+		got += len;
+	}
+	return got;
+}
+
+// the next line of a file being dumped without its newline. A line longer than the buffer comes back in
+// pieces. Returns its length or -1 at the end of the file.
+static int16_t
+dump_line (struct fat_file_struct *fd, char *line, uint16_t size)
+{
+	uint16_t len = 0;
+	uint8_t c;
+
+	while (len < size - 1)
+	{
+		if (dump_read (fd, &c, 1) != 1)
+		{
+			if (len == 0)
+				return -1;
+			break;
+		}
+		if (c == '\n')
+			break;
+		line[len++] = c;
+	}
+	line[len] = 0;
+	return len;
 }
 
 
-// store a record in the sd card filesystem in printable form
+// print a file for the type command, or the lines with data in them for find. Binary logs are decoded back
+// into text a record at a time. Uses log_sector, so the log must have been flushed first.
+static void
+dump_file (struct fat_file_struct *fd, const char *filename, const char *data)
+{
+	char buffer[140];
+	uint16_t extra;
+	LOG_HEADER header;
+
+	dump_len = 0;
+	dump_pos = 0;
+
+	if ((dump_read (fd, (uint8_t *) &header, sizeof (header)) == sizeof (header)) &&
+		 (memcmp (header.magic, LOG_MAGIC, sizeof (header.magic)) == 0))
+	{
+		LOG_RECORD rec;
+
+		if ((header.version > LOG_VERSION) || (header.record_size < sizeof (LOG_RECORD)) ||
+			 (header.header_size < sizeof (header)))
+		{
+			kfile_printf (&serial.fd, "unknown log format in %s\r\n", filename);
+			return;
+		}
+
+		// skip anything a later version has added to the end of the header or of a record
+		extra = header.header_size - sizeof (header);
+		if (dump_read (fd, NULL, extra) != extra)
+			return;
+
+		extra = header.record_size - sizeof (rec);
+		while (dump_read (fd, (uint8_t *) &rec, sizeof (rec)) == sizeof (rec))
+		{
+			if ((kfile_getc (&serial.fd) & 0x7f) == 0x1b)
+				break;
+
+			if (dump_read (fd, NULL, extra) != extra)
+				break;
+
+			format_record (&rec, buffer);
+			if ((data == NULL) || strstr (buffer, data))
+				kfile_printf (&serial.fd, "%s", buffer);
+		}
+		return;
+	}
+
+	// plain text so start again from the beginning, which is still in the buffer
+	dump_pos = 0;
+
+	while (dump_line (fd, buffer, sizeof (buffer)) >= 0)
+	{
+		if ((kfile_getc (&serial.fd) & 0x7f) == 0x1b)
+			break;
+
+		// if doing a find then see if the data is present in this line
+		if ((data == NULL) || strstr (buffer, data))
+			kfile_printf (&serial.fd, "%s\n", buffer);
+	}
+}
+
+// store a record in the sd card filesystem, in printable form unless LOG_BINARY is set
 static void
-log_store (uint8_t event)
+log_store (const LOG_RECORD * rec)
 {
 	char filename[20];
-	char print_buffer[140];
 
-	// make a new log file name each day - now allows long filenames!!
-	sprintf (filename, "log-%02d%02d%02d.txt", gYEAR, gMONTH, gDAY);
+	// use the record's date, not today's, in case it was queued just before midnight
+	sprintf (filename, LOG_NAME, rec->year, rec->month, rec->day);
+
+#if LOG_BINARY
+	file_action (filename, FA_WRITE, (char *) rec, sizeof (LOG_RECORD));
+#else
+	char print_buffer[140];
 
-	format_record (event, print_buffer);
+	format_record (rec, print_buffer);
 
-	file_action (filename, FA_WRITE, print_buffer);
+	file_action (filename, FA_WRITE, print_buffer, strlen (print_buffer));
+#endif
 
 }
 
 
 // output a record in printable form to the uart
 static void
-log_print (uint8_t event)
+log_print (const LOG_RECORD * rec)
 {
 	char print_buffer[140];
 
-	format_record (event, print_buffer);
+	format_record (rec, print_buffer);
 	kfile_printf (&serial.fd, "%s", print_buffer);
 
 }
@@ -413,7 +830,10 @@ process_command (char *command, uint8_t count)
 
 	if (count == 0)				  // display now (empty input!!)
 	{
-		log_print (LOG_NULL);
+		LOG_RECORD rec;
+
+		log_snapshot (LOG_NULL, &rec);
+		log_print (&rec);
 	}
 
 	else if (strncmp (command, "init", 4) == 0)	// first time init
@@ -492,6 +912,16 @@ process_command (char *command, uint8_t count)
 		do_command (MANUALSTOP);
 	}
 
+	else if (strncmp (command, "bus", 3) == 0)	// how the 1-wire devices are getting on
+	{
+		owdev_report ();
+	}
+
+	else if (strncmp (command, "scan", 4) == 0)	// search the 1-wire bus for devices added since startup
+	{
+		kfile_printf (&serial.fd, "Found %d devices, restart to use new ones\r\n", owdev_search ());
+	}
+
 	else if (strncmp (command, "log", 3) == 0)
 	{
 		gLive = !gLive;
@@ -574,12 +1004,12 @@ process_command (char *command, uint8_t count)
 
 	else if (strncmp (command, "dir", 3) == 0)
 	{
-		file_action (NULL, FA_LS, NULL);
+		file_action (NULL, FA_LS, NULL, 0);
 	}
 
 	else if (strncmp (command, "disk", 4) == 0)
 	{
-		file_action (NULL, FA_DISK, NULL);
+		file_action (NULL, FA_DISK, NULL, 0);
 	}
 
 	// cat <filename>
@@ -588,7 +1018,7 @@ process_command (char *command, uint8_t count)
 		command += 5;
 		while (*command == ' ')
 			command++;
-		file_action (command, FA_CAT, NULL);
+		file_action (command, FA_CAT, NULL, 0);
 	}
 
 	// rm <filename>
@@ -599,7 +1029,7 @@ process_command (char *command, uint8_t count)
 			command++;
 		if (command[0] == '\0')
 			return;
-		file_action (command, FA_RM, NULL);
+		file_action (command, FA_RM, NULL, 0);
 	}
 
 	// find [-<days>] <string>
@@ -631,9 +1061,9 @@ process_command (char *command, uint8_t count)
 		}
 		while ((int16_t)days >= 0)
 		{
-			sprintf (filename, "log-%02d%02d%02d.txt", gYEAR, gMONTH, gDAY - days);
+			sprintf (filename, LOG_NAME, gYEAR, gMONTH, gDAY - days);
 			kfile_printf(&serial.fd, "Checking %s for %s\r\n", filename, command);
-			file_action (filename, FA_FIND, command);
+			file_action (filename, FA_FIND, command, 0);
 			days--;
 		}
 	}
@@ -641,6 +1071,7 @@ process_command (char *command, uint8_t count)
 	else if (strncmp (command, "config", 6) == 0)
 	{
 		char tritext[4][5] = {"off", "on", "auto", "" };
+		uint16_t late, worst, missed;
 
 		kfile_printf(&serial.fd, "System %dV, inverter %s\r\n", gVoltage, tritext[gInverter]); 
 		kfile_printf(&serial.fd, "Low - High limits   %d.%02u - %d.%02u\r\n", gVlower / 100, gVlower % 100, gVupper / 100, gVupper % 100);
@@ -648,9 +1079,18 @@ process_command (char *command, uint8_t count)
 		kfile_printf(&serial.fd, "Min/Max Charge - Bank    %d/%d - %d\r\n", gMinCharge, gMaxCharge,  gBankSize);
 		kfile_printf(&serial.fd, "Self Discharge - Leak    %d  - %d.%02u\r\n", gSelfDischarge, gIdleCurrent / 100, gIdleCurrent % 100);
 		kfile_printf(&serial.fd, "Float Cycle - Target     %d/%d - %d\r\n", gDischarge, gMaxDischarge, TargetC);
+		kfile_printf(&serial.fd, "Log queue peak - dropped %d - %u\r\n", gLogPeak, gLogDropped);
+		ATOMIC(
+			late = gCtlLate;
+			worst = gCtlWorst;
+			missed = gCtlMissed;
+		);
+		kfile_printf(&serial.fd, "Control late/worst - missed %u/%lumS - %u\r\n", late, (unsigned long) ticks_to_ms (worst), missed);
+		measure_report();
 #if DEBUG > 0
-extern int16_t gLoops;
+extern int16_t gLoops, gPasses;
 		kfile_printf(&serial.fd, "Loop                     %d\r\n", gLoops);
+		kfile_printf(&serial.fd, "Pass                     %d\r\n", gPasses);
 extern uint16_t StackCount(void);
 		kfile_printf(&serial.fd, "Stack free       %d\r\n", StackCount());
 #endif
@@ -659,7 +1099,7 @@ extern uint16_t StackCount(void);
 	else
 	{
 		kfile_printf (&serial.fd, "Version " VERSION "\r\nCommands: ");
-		kfile_printf (&serial.fd, "cal del dir type disk dcs init inv log date time find config sync uptime\r\n");
+		kfile_printf (&serial.fd, "cal del dir type disk dcs init inv log date time find config sync uptime scan bus\r\n");
 	}
 
 //	kfile_printf(&serial.fd, ">> ");
@@ -673,6 +1113,7 @@ run_log (void)
 {
 	static int16_t LastTimerstamp = 0xff;
 	int16_t c;
+	uint8_t i;
 	static uint8_t bcnt = 0;
 #define CBSIZE 20
 	static char cbuff[CBSIZE];	  /* console I/O buffer       */
@@ -686,6 +1127,24 @@ run_log (void)
 		log_event (LOG_MARKTIME);
 	}
 
+// don't leave log data sitting in RAM for too long
+	if (log_dirty && (uptime () - log_since >= LOG_FLUSH_AGE) && (!log_flush ()))
+	{
+		fs_unmount ();
+		sd_ok = false;
+	}
+
+// write out a limited number of queued records so that logging can't hold up the control loop for long
+	for (i = 0; (i < LOG_DRAIN_PER_PASS) && (log_count > 0); i++)
+	{
+		LOG_RECORD *rec = &log_queue[(log_head + LOG_QUEUE_SIZE - log_count) % LOG_QUEUE_SIZE];
+
+		log_store (rec);
+		if (gLive)
+			log_print (rec);
+		log_count--;
+	}
+
 // poll uart RX and act on received character
 #if PUSHBUTTONS != 1
 	return;		// if no pushbuttons then I'm using the uart input for LCD menu
@@ -729,13 +1188,21 @@ run_log (void)
 }
 
 
-// store a record with timestamp and flags according to input parameter
+// queue a record with timestamp and flags according to input parameter. The record is written to the card
+// (and printed if live) by run_log. If the queue is full the new record is dropped and counted.
 void
 log_event (uint8_t event)
 {
 
-	log_store (event);
+	if (log_count >= LOG_QUEUE_SIZE)
+	{
+		gLogDropped++;
+		return;
+	}
+
+	log_snapshot (event, &log_queue[log_head]);
+	log_head = (log_head + 1) % LOG_QUEUE_SIZE;
 
-	if (gLive)
-		log_print (event);
+	if (++log_count > gLogPeak)
+		gLogPeak = log_count;
 }
@@ -28,6 +28,47 @@ void log_event (uint8_t event);
 void log_clear (void);
 
 extern bool sd_ok;
+extern uint16_t gLogDropped;
+extern uint8_t gLogPeak;
+
+// snapshot of the system taken when an event is logged, held in a queue until run_log writes it out
+typedef struct
+{
+	uint8_t day;
+	uint8_t month;
+	uint8_t year;
+	uint8_t hour;
+	uint8_t minute;
+	uint8_t second;
+	uint8_t flags;              // event value and bit flags
+	int8_t dump;                // shunt duty cycle 0-100%
+	int16_t volts;
+	int16_t amps;
+	int16_t charge;
+	int16_t temp;
+	int16_t rpm;
+	int16_t maxrpm;
+	int16_t maxhour;
+	int16_t maxday;
+	int16_t minhour;
+	int16_t minday;
+	uint16_t cca;
+	uint16_t dca;
+} LOG_RECORD;
+
+// a binary log file (LOG_BINARY) starts with this header followed by LOG_RECORDs exactly as laid out
+// above on the AVR, i.e. little endian with no padding. Decoded on the host by tools/tlogdump.c
+typedef struct
+{
+	char magic[4];              // LOG_MAGIC
+	uint8_t version;            // LOG_VERSION
+	uint8_t header_size;        // sizeof (LOG_HEADER), records start here
+	uint8_t record_size;        // sizeof (LOG_RECORD)
+	uint8_t reserved[9];
+} LOG_HEADER;
+
+#define LOG_MAGIC       "TLOG"
+#define LOG_VERSION     1
 
 #define LOG_LEVEL LOG_LVL_WARN
 
@@ -47,6 +88,7 @@ extern bool sd_ok;
 #define LOG_NEWDAYMIN   13
 #define LOG_LEAKADJUST  14
 #define LOG_IDLEADJUST  15
+#define LOG_BUS         16      // a 1-wire device started failing (with LOG_ERROR) or came right again
 
 #define LOG_MASK_VALUE  0x1f
 // bit flags
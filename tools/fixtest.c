@@ -0,0 +1,211 @@
+//---------------------------------------------------------------------------
+// Copyright (C) 2012 Robin Gilks
+//
+//
+//  fixtest.c   -   Check the fixed point helpers against the float arithmetic they replaced
+//
+//  History:   1.0 - First release.
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+// Build with:   cc -O2 -iquote . -o fixtest tools/fixtest.c -lm
+// Run with:     ./fixtest                  exits with 1 if anything is more than 1 LSB out
+//
+// Each helper in fixed.h is run over its input range (every value where that's practical, a regular
+// sample of the rest) and compared with the same sum done in double precision. Then the expressions
+// measure.c and control.c were converted from are run both ways, the old way in float since that's
+// all the AVR has (its double is a float), over the values those variables take. Out of range float
+// results are saturated as the fixed point code does, the old conversion left them undefined.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "fixed.h"
+
+#define NOMINALVOLTS 7				  // as measure.c
+
+typedef struct
+{
+	const char *name;
+	unsigned long checked;
+	long worst;						  // biggest difference seen, in LSBs
+	long a, b, c;					  // inputs that gave it
+} CASE;
+
+static int failed = 0;
+
+static void
+check (CASE * t, long got, long want, long a, long b, long c)
+{
+	long diff = labs (got - want);
+
+	t->checked++;
+	if ((t->checked == 1) || (diff > t->worst))
+	{
+		t->worst = diff;
+		t->a = a;
+		t->b = b;
+		t->c = c;
+	}
+}
+
+static void
+report (CASE * t)
+{
+	printf ("%-22s %11lu %6ld   %ld %ld %ld%s\n", t->name, t->checked, t->worst, t->a, t->b, t->c,
+			  t->worst > 1 ? "   FAIL" : "");
+	if (t->worst > 1)
+		failed = 1;
+}
+
+// what an int16_t assignment of a float or double would give, except saturated rather than undefined
+static long
+sat (double v)
+{
+	v = trunc (v);
+	if (v > INT16_MAX)
+		return INT16_MAX;
+	if (v < INT16_MIN)
+		return INT16_MIN;
+	return (long) v;
+}
+
+// every value of one argument against a sample of the other, with the awkward ones always included
+#define STEP 61
+static const long edges[] = { INT16_MIN, INT16_MIN + 1, -FIX_ONE, -1, 0, 1, FIX_ONE, INT16_MAX - 1, INT16_MAX };
+
+#define NEDGES ((int) (sizeof (edges) / sizeof (edges[0])))
+
+static long
+sample (int i)
+{
+	return (i < NEDGES) ? edges[i] : INT16_MIN + (long) (i - NEDGES) * STEP;
+}
+
+#define NSAMPLES (NEDGES + 65536 / STEP + 1)
+
+static void
+helpers (void)
+{
+	CASE scale = { .name = "fix_scale" }, mul = { .name = "fix_mul" }, div = { .name = "fix_div" };
+	CASE muldiv = { .name = "fix_muldiv" }, add = { .name = "fix_add_sat" }, subt = { .name = "fix_sub_sat" };
+	CASE from = { .name = "fix_from_float" };
+	long a, b, c;
+	int i;
+
+	for (i = 0; i < NSAMPLES; i++)
+	{
+		b = sample (i);
+		for (a = INT16_MIN; a <= INT16_MAX; a++)
+		{
+			check (&scale, fix_scale (a, b), sat ((double) a * b / FIX_ONE), a, b, 0);
+			check (&mul, fix_mul (a, b), sat ((double) a * b / FIX_ONE), a, b, 0);
+			check (&add, fix_add_sat (a, b), sat ((double) a + b), a, b, 0);
+			check (&subt, fix_sub_sat (a, b), sat ((double) a - b), a, b, 0);
+			if (b)
+				check (&div, fix_div (a, b), sat ((double) a * FIX_ONE / b), a, b, 0);
+			else
+				check (&div, fix_div (a, b), a < 0 ? INT16_MIN : INT16_MAX, a, b, 0);
+		}
+	}
+
+	// three arguments is too many to go through, so random ones with plenty at the ends of the range
+	srand (1);
+	for (i = 0; i < 20000000; i++)
+	{
+		a = (i & 1) ? (rand () & 0xffff) + INT16_MIN : sample (rand () % NSAMPLES);
+		b = (i & 2) ? (rand () & 0xffff) + INT16_MIN : sample (rand () % NSAMPLES);
+		c = (i & 4) ? (rand () & 0xffff) + INT16_MIN : sample (rand () % NSAMPLES);
+		check (&muldiv, fix_muldiv (a, b, c), c ? sat ((double) a * b / c) : 0, a, b, c);
+	}
+
+	// settings are floats, go through -2.5 to 2.5 in steps well under 1 LSB and right up to the limits.
+	// b is x in millionths in the report
+	for (i = -2500000; i <= 2500000; i++)
+	{
+		float x = i / 1000000.0f;
+		check (&from, fix_from_float (x), lround (fmin (fmax (x * (double) FIX_ONE, INT16_MIN), INT16_MAX)), 0, i, 0);
+	}
+	check (&from, fix_from_float (nextafterf (2.0f, 0.0f)), INT16_MAX, 0, 2000000, 0);
+	check (&from, fix_from_float (nextafterf (-2.0f, 0.0f)), INT16_MIN, 0, -2000000, 0);
+
+	report (&scale);
+	report (&mul);
+	report (&div);
+	report (&muldiv);
+	report (&add);
+	report (&subt);
+	report (&from);
+}
+
+static void
+expressions (void)
+{
+	CASE power = { .name = "gPower" }, cal = { .name = "Volts * gVoffset" };
+	CASE decay = { .name = "gCharge * 0.99" }, bank = { .name = "gBankSize * 0.90" };
+	CASE low = { .name = "gVupper * 0.98" }, comp = { .name = "temperature comp" };
+	static const int voltages[] = { 12, 24, 36, 48 };
+	long a, b, v;
+	int i;
+
+	// amps either way in 1/100ths of an amp against up to 100V in 1/100ths
+	for (a = INT16_MIN; a <= INT16_MAX; a += 3)
+		for (b = 0; b <= 10000; b += 7)
+			check (&power, fix_muldiv (a, b, 10000), sat ((float) a * (float) b / 10000.0f), a, b, 0);
+
+	// the DS2438 reads up to 10.23V in 10mV steps, the calibration is a few percent either way of 1.0.
+	// b is gVoffset in millionths
+	for (i = 0; i < (int) (sizeof (voltages) / sizeof (voltages[0])); i++)
+		for (b = 800000; b <= 1200000; b += 250)
+		{
+			float offset = b / 1000000.0f;
+			fix_t k = fix_from_float (offset);
+
+			for (a = 0; a <= 1023; a++)
+			{
+				v = a * voltages[i] / NOMINALVOLTS;
+				check (&cal, fix_scale (v, k), sat (v * offset), a, b, voltages[i]);
+			}
+		}
+
+	// charge, bank size and voltages are positive but go through the lot anyway
+	for (a = INT16_MIN; a <= INT16_MAX; a++)
+	{
+		check (&decay, fix_scale (a, FIX (0.99)), sat (a * (float) 0.99), a, 0, 0);
+		check (&bank, fix_scale (a, FIX (0.90)), sat (a * (float) 0.90), a, 0, 0);
+		check (&low, fix_scale (a, FIX (0.98)), sat (a * (float) 0.98), a, 0, 0);
+	}
+
+	// set points up to 80V against -40 to 85 degC in 1/100ths
+	for (a = 0; a <= 8000; a += 3)
+		for (b = -4000; b <= 8500; b++)
+			check (&comp, fix_sub_sat (a, fix_scale (b - 2500, FIX (0.005))), sat (a - (float) 0.005 * (b - 2500)), a, b, 0);
+
+	report (&power);
+	report (&cal);
+	report (&decay);
+	report (&bank);
+	report (&low);
+	report (&comp);
+}
+
+int
+main (void)
+{
+	printf ("%-22s %11s %6s   %s\n", "", "checked", "worst", "at");
+	helpers ();
+	expressions ();
+	return failed;
+}
@@ -0,0 +1,210 @@
+//---------------------------------------------------------------------------
+// Copyright (C) 2012 Robin Gilks
+//
+//
+//  blockdev.c   -   Disk image block device for running the FAT code on a host
+//
+//  History:   1.0 - First release.
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+// The image file is mapped into memory and the partition callbacks copy in and out of the mapping,
+// so whatever the FAT code does ends up in the file for fsck.fat or mount to look at afterwards.
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "blockdev.h"
+
+BLOCKDEV_STATS blockdev_stats;
+
+static uint8_t *image = NULL;
+static uint64_t image_size = 0;
+
+// number of 512 byte blocks a transfer touches
+static uint64_t
+blocks (offset_t offset, uintptr_t length)
+{
+	if (length == 0)
+		return 0;
+	return (offset + length - 1) / 512 - offset / 512 + 1;
+}
+
+static int
+in_range (offset_t offset, uintptr_t length)
+{
+	return (image != NULL) && (offset <= image_size) && (length <= image_size - offset);
+}
+
+// open an image, creating it or growing it to size if that is given. A size of 0 uses the file as it is.
+int
+blockdev_open (const char *path, uint64_t size)
+{
+	int fd;
+	off_t len;
+	void *map;
+
+	fd = open (path, size ? O_RDWR | O_CREAT : O_RDWR, 0644);
+	if (fd < 0)
+	{
+		perror (path);
+		return 0;
+	}
+
+	if (size && ftruncate (fd, (off_t) size) != 0)
+	{
+		perror (path);
+		close (fd);
+		return 0;
+	}
+
+	len = lseek (fd, 0, SEEK_END);
+	if (len <= 0)
+	{
+		fprintf (stderr, "%s: empty image\n", path);
+		close (fd);
+		return 0;
+	}
+
+	map = mmap (NULL, (size_t) len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close (fd);
+	if (map == MAP_FAILED)
+	{
+		perror (path);
+		return 0;
+	}
+
+	image = map;
+	image_size = (uint64_t) len;
+	memset (&blockdev_stats, 0, sizeof (blockdev_stats));
+	return 1;
+}
+
+void
+blockdev_close (void)
+{
+	if (image)
+	{
+		msync (image, (size_t) image_size, MS_SYNC);
+		munmap (image, (size_t) image_size);
+	}
+	image = NULL;
+	image_size = 0;
+}
+
+uint8_t *
+blockdev_image (void)
+{
+	return image;
+}
+
+uint64_t
+blockdev_size (void)
+{
+	return image_size;
+}
+
+uint8_t
+blockdev_read (offset_t offset, uint8_t * buffer, uintptr_t length)
+{
+	if (!in_range (offset, length))
+		return 0;
+
+	memcpy (buffer, image + offset, length);
+	blockdev_stats.reads++;
+	blockdev_stats.blocks_read += blocks (offset, length);
+	return 1;
+}
+
+// same contract as sd_raw_read_interval
+uint8_t
+blockdev_read_interval (offset_t offset, uint8_t * buffer, uintptr_t interval, uintptr_t length, device_read_callback_t callback, void *p)
+{
+	if (!buffer || interval == 0 || length < interval || !callback)
+		return 0;
+
+	while (length >= interval)
+	{
+		if (!blockdev_read (offset, buffer, interval))
+			return 0;
+		if (!callback (buffer, offset, p))
+			break;
+		offset += interval;
+		length -= interval;
+	}
+	return 1;
+}
+
+uint8_t
+blockdev_write (offset_t offset, const uint8_t * buffer, uintptr_t length)
+{
+	if (!in_range (offset, length))
+		return 0;
+
+	memcpy (image + offset, buffer, length);
+	blockdev_stats.writes++;
+	blockdev_stats.blocks_written += blocks (offset, length);
+	return 1;
+}
+
+// same contract as sd_raw_write_interval
+uint8_t
+blockdev_write_interval (offset_t offset, uint8_t * buffer, uintptr_t length, device_write_callback_t callback, void *p)
+{
+	uint8_t endless = (length == 0);
+
+	if (!buffer || !callback)
+		return 0;
+
+	while (endless || length > 0)
+	{
+		uintptr_t n = callback (buffer, offset, p);
+		if (!n)
+			break;
+		if (!endless && n > length)
+			return 0;
+		if (!blockdev_write (offset, buffer, n))
+			return 0;
+		offset += n;
+		length -= n;
+	}
+	return 1;
+}
+
+uint8_t
+blockdev_read_blocks (offset_t offset, uint8_t * buffer, uint16_t count)
+{
+	if ((offset & 0x1ff) || !in_range (offset, (uintptr_t) count * 512))
+		return 0;
+
+	memcpy (buffer, image + offset, (size_t) count * 512);
+	blockdev_stats.bulk++;
+	blockdev_stats.blocks_read += count;
+	return 1;
+}
+
+uint8_t
+blockdev_write_blocks (offset_t offset, const uint8_t * buffer, uint16_t count)
+{
+	if ((offset & 0x1ff) || !in_range (offset, (uintptr_t) count * 512))
+		return 0;
+
+	memcpy (image + offset, buffer, (size_t) count * 512);
+	blockdev_stats.bulk++;
+	blockdev_stats.blocks_written += count;
+	return 1;
+}
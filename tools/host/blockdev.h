@@ -0,0 +1,54 @@
+//---------------------------------------------------------------------------
+// Copyright (C) 2012 Robin Gilks
+//
+//
+//  blockdev.h   -   Disk image block device for running the FAT code on a host
+//
+//  History:   1.0 - First release.
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+#ifndef BLOCKDEV_H
+#define BLOCKDEV_H
+
+#include <stdint.h>
+
+#include "partition.h"
+
+// what has been asked of the device. A block is counted each time a call touches it, which is
+// what a card without any caching would have to transfer.
+typedef struct
+{
+	uint32_t reads;				  // calls to read, including each interval of an interval read
+	uint32_t writes;				  // calls to write, including each piece of an interval write
+	uint32_t bulk;				  // calls to the whole block functions, one command to the card however many
+	uint64_t blocks_read;
+	uint64_t blocks_written;
+} BLOCKDEV_STATS;
+
+extern BLOCKDEV_STATS blockdev_stats;
+
+int blockdev_open (const char *path, uint64_t size);
+void blockdev_close (void);
+uint8_t *blockdev_image (void);
+uint64_t blockdev_size (void);
+
+uint8_t blockdev_read (offset_t offset, uint8_t * buffer, uintptr_t length);
+uint8_t blockdev_read_interval (offset_t offset, uint8_t * buffer, uintptr_t interval, uintptr_t length, device_read_callback_t callback, void *p);
+uint8_t blockdev_write (offset_t offset, const uint8_t * buffer, uintptr_t length);
+uint8_t blockdev_write_interval (offset_t offset, uint8_t * buffer, uintptr_t length, device_write_callback_t callback, void *p);
+uint8_t blockdev_read_blocks (offset_t offset, uint8_t * buffer, uint16_t count);
+uint8_t blockdev_write_blocks (offset_t offset, const uint8_t * buffer, uint16_t count);
+
+#endif
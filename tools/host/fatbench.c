@@ -0,0 +1,413 @@
+//---------------------------------------------------------------------------
+// Copyright (C) 2012 Robin Gilks
+//
+//
+//  fatbench.c   -   Replay a month of logging against FAT16 and FAT32 disk images
+//
+//  History:   1.0 - First release.
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+// Runs the same FAT code as the logger against an image file so changes to it can be measured and the
+// result checked with fsck.fat. Each day gets a log file preallocated and filled the way tlog.c does it
+// (a sector buffer flushed when full or 10 minutes old, the file synced on every flush), the directory is
+// listed every hour and the day's file is dumped and searched the way the 'cat' and 'find' commands do it.
+// Both of those have to have gone through the whole block read or the run counts as a failure.
+//
+// Build with: cc -O2 -Itools/host -iquote . -o fatbench tools/host/*.c fat.c partition.c byteordering.c
+// Run with:   ./fatbench [days]          leaves fat16.img and fat32.img behind for fsck.fat -n
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "fat.h"
+#include "partition.h"
+#include "blockdev.h"
+#include "mkimage.h"
+
+#define RECORDS_PER_DAY 1700				  // same as LOG_RECORDS_PER_DAY
+#define PREALLOC ((uint32_t) RECORDS_PER_DAY * 128)
+#define SECTOR 512
+#define FLUSH_AGE 600
+
+enum PHASES
+{
+	PH_LOG,
+	PH_LS,
+	PH_CAT,
+	PH_FIND,
+	PH_COUNT
+};
+
+static const char *phase_name[PH_COUNT] = { "append", "ls", "cat", "find" };
+
+typedef struct
+{
+	uint32_t ops;
+	BLOCKDEV_STATS dev;
+	double secs;
+} PHASE;
+
+static PHASE phase[PH_COUNT];
+static BLOCKDEV_STATS mark;
+static struct timespec mark_time;
+
+// simulated wall clock used for the directory entry time stamps
+static time_t now;
+
+void
+get_datetime (uint16_t * year, uint8_t * month, uint8_t * day, uint8_t * hour, uint8_t * min, uint8_t * sec)
+{
+	struct tm tm;
+
+	gmtime_r (&now, &tm);
+	*year = tm.tm_year + 1900;
+	*month = tm.tm_mon + 1;
+	*day = tm.tm_mday;
+	*hour = tm.tm_hour;
+	*min = tm.tm_min;
+	*sec = tm.tm_sec;
+}
+
+static void
+phase_start (void)
+{
+	mark = blockdev_stats;
+	clock_gettime (CLOCK_MONOTONIC, &mark_time);
+}
+
+static void
+phase_end (enum PHASES p)
+{
+	struct timespec t;
+
+	clock_gettime (CLOCK_MONOTONIC, &t);
+	phase[p].ops++;
+	phase[p].dev.reads += blockdev_stats.reads - mark.reads;
+	phase[p].dev.writes += blockdev_stats.writes - mark.writes;
+	phase[p].dev.bulk += blockdev_stats.bulk - mark.bulk;
+	phase[p].dev.blocks_read += blockdev_stats.blocks_read - mark.blocks_read;
+	phase[p].dev.blocks_written += blockdev_stats.blocks_written - mark.blocks_written;
+	phase[p].secs += (t.tv_sec - mark_time.tv_sec) + (t.tv_nsec - mark_time.tv_nsec) / 1e9;
+}
+
+static int
+find_file (struct fat_dir_struct *dd, const char *name, struct fat_dir_entry_struct *dir_entry)
+{
+	while (fat_read_dir (dd, dir_entry))
+	{
+		if (strcmp (dir_entry->long_name, name) == 0)
+		{
+			fat_reset_dir (dd);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+// the logger's sector buffer
+static uint8_t sector[SECTOR];
+static uint16_t fill;
+static uint32_t sector_pos;
+static time_t dirty_since;
+static int dirty;
+
+static int
+flush (struct fat_file_struct *fd)
+{
+	int32_t offset;
+
+	if (!dirty)
+		return 1;
+	if (fat_write_file (fd, sector, fill) != fill)
+		return 0;
+	if (fill == SECTOR)
+	{
+		sector_pos += SECTOR;
+		fill = 0;
+	}
+	else
+	{
+		offset = -(int32_t) fill;
+		if (!fat_seek_file (fd, &offset, FAT_SEEK_CUR))
+			return 0;
+	}
+	dirty = 0;
+	return fat_sync_file (fd);
+}
+
+static int
+append (struct fat_file_struct *fd, const char *line)
+{
+	uint16_t len = strlen (line);
+
+	while (len > 0)
+	{
+		uint16_t n = SECTOR - fill;
+		if (n > len)
+			n = len;
+		memcpy (sector + fill, line, n);
+		fill += n;
+		line += n;
+		len -= n;
+		if (!dirty)
+		{
+			dirty = 1;
+			dirty_since = now;
+		}
+		if ((fill == SECTOR) && !flush (fd))
+			return 0;
+	}
+	return 1;
+}
+
+static void
+list (struct fat_dir_struct *dd)
+{
+	struct fat_dir_entry_struct dir_entry;
+
+	phase_start ();
+	while (fat_read_dir (dd, &dir_entry))
+		;
+	phase_end (PH_LS);
+}
+
+// files are read back through the logger's sector buffer a sector at a time, as tlog.c does it
+static uint16_t dump_len;
+static uint16_t dump_pos;
+
+static uint16_t
+dump_read (struct fat_file_struct *fd, uint8_t * dst, uint16_t n)
+{
+	uint16_t got = 0;
+	uint16_t len;
+	intptr_t r;
+
+	while (got < n)
+	{
+		if (dump_pos >= dump_len)
+		{
+			r = fat_read_file (fd, sector, SECTOR);
+			if (r <= 0)
+				break;
+			dump_len = r;
+			dump_pos = 0;
+		}
+
+		len = dump_len - dump_pos;
+		if (len > n - got)
+			len = n - got;
+		if (dst)
+			memcpy (dst + got, sector + dump_pos, len);
+		dump_pos += len;
+		got += len;
+	}
+	return got;
+}
+
+static int16_t
+dump_line (struct fat_file_struct *fd, char *line, uint16_t size)
+{
+	uint16_t len = 0;
+	uint8_t c;
+
+	while (len < size - 1)
+	{
+		if (dump_read (fd, &c, 1) != 1)
+		{
+			if (len == 0)
+				return -1;
+			break;
+		}
+		if (c == '\n')
+			break;
+		line[len++] = c;
+	}
+	line[len] = 0;
+	return len;
+}
+
+// read a file the way the cat (data NULL) or find command does, a line at a time through the dump buffer.
+// Returns the number of lines printed.
+static uint32_t
+dump (struct fat_fs_struct *fs, struct fat_dir_struct *dd, const char *name, const char *data, enum PHASES p)
+{
+	struct fat_dir_entry_struct file_entry;
+	struct fat_file_struct *fd;
+	char buffer[140];
+	uint32_t hits = 0;
+
+	phase_start ();
+	if (!find_file (dd, name, &file_entry) || !(fd = fat_open_file (fs, &file_entry)))
+	{
+		phase_end (p);
+		return 0;
+	}
+	dump_len = 0;
+	dump_pos = 0;
+
+	while (dump_line (fd, buffer, sizeof (buffer)) >= 0)
+	{
+		if ((data == NULL) || strstr (buffer, data))
+			hits++;
+	}
+	fat_close_file (fd);
+	phase_end (p);
+	return hits;
+}
+
+// one day of records in a new file, returns the number written or -1 if anything failed
+static int
+log_day (struct fat_fs_struct *fs, struct fat_dir_struct *dd, const char *name)
+{
+	struct fat_dir_entry_struct file_entry;
+	struct fat_file_struct *fd;
+	time_t start = now;
+	char line[128];
+	int rec, hour = -1;
+
+	phase_start ();
+	if (!fat_create_file (dd, name, &file_entry) || !(fd = fat_open_file (fs, &file_entry)))
+		return -1;
+	if (!fat_preallocate_file (fd, PREALLOC))
+		printf ("%s: no room to preallocate\n", name);
+	fill = 0;
+	sector_pos = 0;
+	dirty = 0;
+
+	for (rec = 0; rec < RECORDS_PER_DAY; rec++)
+	{
+		struct tm tm;
+
+		now = start + (time_t) rec * 86400 / RECORDS_PER_DAY;
+		gmtime_r (&now, &tm);
+
+		// the logger would list the card or search it between records now and then
+		if (tm.tm_hour != hour)
+		{
+			hour = tm.tm_hour;
+			phase_end (PH_LOG);
+			list (dd);
+			phase_start ();
+		}
+
+		snprintf (line, sizeof (line), "%02d/%02d/%02d %02d:%02d:%02d,%4d.%02d,%3d.%d,%3d.%d,%5d,%5d,%4d.%d,%4d.%d,%4d,%3d,%5d,%5d,%5d,%4d.%d,%4d.%d,%d\n",
+					 tm.tm_mday, tm.tm_mon + 1, tm.tm_year % 100, tm.tm_hour, tm.tm_min, tm.tm_sec,
+					 rec % 9000, rec % 100, rec % 250, rec % 10, rec % 60, rec % 7, rec * 7 % 20000, rec * 13 % 30000,
+					 rec % 1000, rec % 3, rec % 2000, rec % 9, rec % 255, rec % 120, rec * 3 % 65536, rec * 5 % 30000,
+					 rec * 11 % 30000, rec % 500, rec % 10, rec % 700, rec % 4, rec & 1);
+		if (!append (fd, line))
+			return -1;
+		if (dirty && (now - dirty_since >= FLUSH_AGE) && !flush (fd))
+			return -1;
+	}
+
+	now = start + 86400 - 1;
+	if (!flush (fd) || !fat_resize_file (fd, sector_pos + fill))
+		return -1;
+	fat_close_file (fd);
+	phase_end (PH_LOG);
+	return rec;
+}
+
+static int
+run (enum IMAGETYPE type, const char *path, int days)
+{
+	struct partition_struct *partition;
+	struct fat_fs_struct *fs;
+	struct fat_dir_struct *dd;
+	struct fat_dir_entry_struct directory;
+	char name[40];
+	uint32_t hits = 0, lines = 0;
+	long records = 0;
+	int day, p, n;
+
+	memset (phase, 0, sizeof (phase));
+	if (!mkimage (path, type) || !blockdev_open (path, 0))
+		return 0;
+
+	partition = partition_open (blockdev_read, blockdev_read_interval, blockdev_write, blockdev_write_interval, 0);
+	if (!partition)
+	{
+		printf ("%s: no partition\n", path);
+		return 0;
+	}
+	partition->device_read_blocks = blockdev_read_blocks;
+	partition->device_write_blocks = blockdev_write_blocks;
+
+	fs = fat_open (partition);
+	if (!fs || !fat_get_dir_entry_of_path (fs, "/", &directory) || !(dd = fat_open_dir (fs, &directory)))
+	{
+		printf ("%s: can't open filesystem\n", path);
+		return 0;
+	}
+
+	now = 1338508800;						  // 1 June 2012
+	for (day = 0; day < days; day++)
+	{
+		struct tm tm;
+
+		now = 1338508800 + (time_t) day * 86400;	  // from 1 June 2012
+		gmtime_r (&now, &tm);
+		snprintf (name, sizeof (name), "log-%02d%02d%02d.txt", tm.tm_year % 100, tm.tm_mon + 1, tm.tm_mday);
+
+		n = log_day (fs, dd, name);
+		if (n < 0)
+		{
+			printf ("%s: logging failed on day %d\n", path, day + 1);
+			break;
+		}
+		records += n;
+		lines += dump (fs, dd, name, NULL, PH_CAT);
+		hits += dump (fs, dd, name, ":30:", PH_FIND);
+	}
+
+	printf ("%s: %ld records, %u lines, %u find hits, %lu bytes free\n", path, records, lines, hits,
+			  (unsigned long) fat_get_fs_free (fs));
+	printf ("%-7s %6s %9s %9s %7s %12s %12s %9s\n", "phase", "ops", "reads", "writes", "bulk", "blks read", "blks written", "seconds");
+	for (p = 0; p < PH_COUNT; p++)
+		printf ("%-7s %6u %9u %9u %7u %12llu %12llu %9.3f\n", phase_name[p], phase[p].ops, phase[p].dev.reads, phase[p].dev.writes,
+				  phase[p].dev.bulk, (unsigned long long) phase[p].dev.blocks_read, (unsigned long long) phase[p].dev.blocks_written,
+				  phase[p].secs);
+
+	fat_close_dir (dd);
+	fat_close (fs);
+	partition_close (partition);
+	blockdev_close ();
+
+	if ((lines != (uint32_t) records) || !phase[PH_CAT].dev.bulk || !phase[PH_FIND].dev.bulk)
+	{
+		printf ("%s: files weren't read back whole or not with whole block reads\n", path);
+		return 0;
+	}
+	return 1;
+}
+
+int
+main (int argc, char **argv)
+{
+	int days = (argc > 1) ? atoi (argv[1]) : 30;
+
+	if (days <= 0)
+	{
+		fprintf (stderr, "usage: %s [days]\n", argv[0]);
+		return 1;
+	}
+
+	if (!run (IMAGE_FAT16, "fat16.img", days) || !run (IMAGE_FAT32, "fat32.img", days))
+		return 1;
+	return 0;
+}
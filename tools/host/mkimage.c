@@ -0,0 +1,160 @@
+//---------------------------------------------------------------------------
+// Copyright (C) 2012 Robin Gilks
+//
+//
+//  mkimage.c   -   Make empty FAT16 and FAT32 disk images for the host tools
+//
+//  History:   1.0 - First release.
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+// Lays the images out the way a camera or a PC formats an SD card: an MBR with one partition starting
+// at 1MB and 4k clusters. The FAT32 image gets an FSInfo sector and a backup boot sector so fsck.fat
+// has nothing to complain about on a fresh image.
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "blockdev.h"
+#include "mkimage.h"
+
+#define SECTOR 512
+#define PART_START 2048					  // first sector of the partition
+#define CLUSTER_SECTORS 8
+
+static void
+put16 (uint8_t * p, uint16_t v)
+{
+	p[0] = v;
+	p[1] = v >> 8;
+}
+
+static void
+put32 (uint8_t * p, uint32_t v)
+{
+	put16 (p, v);
+	put16 (p + 2, v >> 16);
+}
+
+int
+mkimage (const char *path, enum IMAGETYPE type)
+{
+	uint64_t size = (type == IMAGE_FAT16) ? 128ULL << 20 : 1ULL << 30;
+	uint32_t sectors = size / SECTOR - PART_START;
+	uint16_t reserved = (type == IMAGE_FAT16) ? 4 : 32;
+	uint16_t root_entries = (type == IMAGE_FAT16) ? 512 : 0;
+	uint8_t entry_size = (type == IMAGE_FAT16) ? 2 : 4;
+	uint32_t root_sectors = root_entries * 32 / SECTOR;
+	uint32_t fat_sectors = 1, clusters = 0, last;
+	uint8_t *disk, *boot, *fat;
+	uint8_t copy;
+
+	// the FAT size depends on the cluster count which depends on the FAT size. It settles in a couple of goes.
+	do
+	{
+		last = fat_sectors;
+		clusters = (sectors - reserved - 2 * fat_sectors - root_sectors) / CLUSTER_SECTORS;
+		fat_sectors = ((clusters + 2) * entry_size + SECTOR - 1) / SECTOR;
+	}
+	while (fat_sectors != last);
+
+	unlink (path);
+	if (!blockdev_open (path, size))
+		return 0;
+	disk = blockdev_image ();
+
+	// partition table, CHS fields say "use the LBA ones"
+	disk[0x1be + 1] = 0xfe;
+	disk[0x1be + 2] = 0xff;
+	disk[0x1be + 3] = 0xff;
+	disk[0x1be + 4] = (type == IMAGE_FAT16) ? 0x06 : 0x0c;
+	disk[0x1be + 5] = 0xfe;
+	disk[0x1be + 6] = 0xff;
+	disk[0x1be + 7] = 0xff;
+	put32 (&disk[0x1be + 8], PART_START);
+	put32 (&disk[0x1be + 12], sectors);
+	put16 (&disk[510], 0xaa55);
+
+	boot = disk + (uint64_t) PART_START *SECTOR;
+	boot[0] = 0xeb;
+	boot[1] = (type == IMAGE_FAT16) ? 0x3c : 0x58;
+	boot[2] = 0x90;
+	memcpy (&boot[3], "MSWIN4.1", 8);
+	put16 (&boot[0x0b], SECTOR);
+	boot[0x0d] = CLUSTER_SECTORS;
+	put16 (&boot[0x0e], reserved);
+	boot[0x10] = 2;
+	put16 (&boot[0x11], root_entries);
+	boot[0x15] = 0xf8;
+	put16 (&boot[0x18], 63);
+	put16 (&boot[0x1a], 255);
+	put32 (&boot[0x1c], PART_START);
+	put32 (&boot[0x20], sectors);
+
+	if (type == IMAGE_FAT16)
+	{
+		put16 (&boot[0x16], fat_sectors);
+		boot[0x24] = 0x80;
+		boot[0x26] = 0x29;
+		put32 (&boot[0x27], 0x12345678);
+		memcpy (&boot[0x2b], "TURBINE    ", 11);
+		memcpy (&boot[0x36], "FAT16   ", 8);
+	}
+	else
+	{
+		uint8_t *info = boot + SECTOR;
+
+		put32 (&boot[0x24], fat_sectors);
+		put32 (&boot[0x2c], 2);		  // root directory cluster
+		put16 (&boot[0x30], 1);		  // FSInfo sector
+		put16 (&boot[0x32], 6);		  // backup boot sector
+		boot[0x40] = 0x80;
+		boot[0x42] = 0x29;
+		put32 (&boot[0x43], 0x12345678);
+		memcpy (&boot[0x47], "TURBINE    ", 11);
+		memcpy (&boot[0x52], "FAT32   ", 8);
+
+		put32 (&info[0], 0x41615252);
+		put32 (&info[484], 0x61417272);
+		put32 (&info[488], clusters - 1);	// all but the root directory
+		put32 (&info[492], 3);
+		put32 (&info[508], 0xaa550000);
+	}
+	put16 (&boot[510], 0xaa55);
+
+	if (type == IMAGE_FAT32)
+		memcpy (boot + 6 * SECTOR, boot, 2 * SECTOR);
+
+	// media byte and end of chain markers, plus the root directory's one cluster on FAT32
+	for (copy = 0; copy < 2; copy++)
+	{
+		fat = boot + ((uint64_t) reserved + (uint64_t) copy * fat_sectors) * SECTOR;
+		if (type == IMAGE_FAT16)
+		{
+			put16 (&fat[0], 0xfff8);
+			put16 (&fat[2], 0xffff);
+		}
+		else
+		{
+			put32 (&fat[0], 0x0ffffff8);
+			put32 (&fat[4], 0x0fffffff);
+			put32 (&fat[8], 0x0fffffff);
+		}
+	}
+
+	printf ("%s: FAT%d, %u clusters of %u bytes\n", path, type, clusters, CLUSTER_SECTORS * SECTOR);
+	blockdev_close ();
+	return 1;
+}
@@ -0,0 +1,35 @@
+//---------------------------------------------------------------------------
+// Copyright (C) 2012 Robin Gilks
+//
+//
+//  mkimage.h   -   Make empty FAT16 and FAT32 disk images for the host tools
+//
+//  History:   1.0 - First release.
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+#ifndef MKIMAGE_H
+#define MKIMAGE_H
+
+#include <stdint.h>
+
+enum IMAGETYPE
+{
+	IMAGE_FAT16 = 16,
+	IMAGE_FAT32 = 32,
+};
+
+int mkimage (const char *path, enum IMAGETYPE type);
+
+#endif
@@ -0,0 +1,242 @@
+//---------------------------------------------------------------------------
+// Copyright (C) 2012 Robin Gilks
+//
+//
+//  medbench.c   -   Check the median filter against the original and time the two
+//
+//  History:   1.0 - First release.
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+// medold.c is median.c from before median_add kept the sorted copy and the sum up to date. Both are fed
+// the same random values (any int16_t, a narrow range with lots of repeats, and ramps) for every window
+// size, with the odd clear and reload of an old eeprom image (median_rebuild) thrown in, and every query
+// has to give the same answer after every add. Then each call is timed per window size, in nS and, on
+// x86, in TSC cycles. These are PC figures, the AVR has no FPU so the float average it used to do costs a
+// lot more there.
+//
+// Build with: cc -O2 -iquote . -Itools/median -o medbench tools/median/*.c median.c
+// Run with:   ./medbench [adds]          exits with 1 if the two ever disagree
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#if defined(__i386__) || defined(__x86_64__)
+#include <x86intrin.h>
+#define HAVE_TSC 1
+#endif
+
+#include "median.h"
+#include "medold.h"
+
+#define TIMED 1000000
+
+static int16_t
+random_value (int kind, long i)
+{
+	switch (kind)
+	{
+	case 0:
+		return (int16_t) (rand () & 0xffff);
+	case 1:
+		return (int16_t) (rand () % 7 - 3);
+	default:
+		return (int16_t) ((i % 97) * 300 - 14000);
+	}
+}
+
+// every query on both after each add, returns 0 and says so on the first difference
+static int
+compare (MEDIAN * M, OLD_MEDIAN * O, long i)
+{
+	int16_t a = 0, b = 0;
+	bool ra, rb;
+
+	if (median_getCount (M) != old_median_getCount (O) || median_getStart (M) != old_median_getStart (O) ||
+		 median_getSize (M) != old_median_getSize (O) || median_getStatus (M) != old_median_getStatus (O))
+	{
+		printf ("add %ld: count/start/size/status differ\n", i);
+		return 0;
+	}
+
+#define SAME(fn) \
+	ra = median_##fn (M, &a); \
+	rb = old_median_##fn (O, &b); \
+	if ((ra != rb) || (ra && (a != b))) \
+	{ \
+		printf ("add %ld, size %u: " #fn " gave %d not %d\n", i, median_getSize (M), a, b); \
+		return 0; \
+	}
+
+	SAME (getMedian);
+	SAME (getAverage);
+	SAME (getHighest);
+	SAME (getLowest);
+	return 1;
+}
+
+// the eeprom copies of PowerDays and PowerHours must stay where and as big as they were
+_Static_assert (sizeof (MEDIAN_STORE) == sizeof (OLD_MEDIAN), "MEDIAN_STORE no longer matches the old eeprom layout");
+
+static int
+check (long adds)
+{
+	MEDIAN M;
+	OLD_MEDIAN O;
+	long i;
+	int size;
+
+	srand (1);
+	// 0 and 21 to 25 make sure the size gets clamped the same way
+	for (size = 0; size <= MAX_MEDIAN + 5; size++)
+	{
+		median_init (&M, size);
+		old_median_init (&O, size);
+
+		for (i = 0; i < adds; i++)
+		{
+			int16_t v = random_value ((i / 1000) % 3, i);
+
+			median_add (&M, v);
+			old_median_add (&O, v);
+			if (!compare (&M, &O, i))
+				return 0;
+
+			if (rand () % 5000 == 0)
+			{
+				median_clear (&M);
+				old_median_clear (&O);
+			}
+			else if (rand () % 5000 == 0)
+			{
+				// what an old unit left in eeprom, loaded the way graph_init does it. The sum isn't stored
+				memset (&M, 0xa5, sizeof (M));
+				memcpy (&M.s, &O, sizeof (M.s));
+				median_rebuild (&M);
+			}
+		}
+	}
+	printf ("%ld adds at each of %d sizes agree with the original\n", adds, MAX_MEDIAN + 6);
+	return 1;
+}
+
+typedef struct
+{
+	double ns;
+	double cycles;
+} TIME;
+
+static volatile int16_t sink;
+static int16_t values[TIMED];
+static struct timespec t0;
+#if HAVE_TSC
+static unsigned long long c0;
+#endif
+
+static void
+start (void)
+{
+	clock_gettime (CLOCK_MONOTONIC, &t0);
+#if HAVE_TSC
+	c0 = __rdtsc ();
+#endif
+}
+
+static TIME
+stop (void)
+{
+	struct timespec t1;
+	TIME t = { 0, 0 };
+
+#if HAVE_TSC
+	t.cycles = (double) (__rdtsc () - c0) / TIMED;
+#endif
+	clock_gettime (CLOCK_MONOTONIC, &t1);
+	t.ns = ((t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec)) / TIMED;
+	return t;
+}
+
+// a loop of TIMED calls of one of them, the window full before it starts
+#define TIMEIT(res, M, init, add, call) \
+	do \
+	{ \
+		init (&M, size); \
+		for (i = 0; i < size; i++) \
+			add (&M, values[i]); \
+		start (); \
+		for (i = 0; i < TIMED; i++) \
+		{ \
+			call; \
+		} \
+		res = stop (); \
+	} while (0)
+
+static void
+bench (void)
+{
+	static const int sizes[] = { 5, 10, 20 };
+	static const char *names[] = { "add", "getMedian", "getAverage", "add+both" };
+	MEDIAN M;
+	OLD_MEDIAN O;
+	TIME t[2][4];
+	int16_t v;
+	long i;
+	int s, c;
+
+	srand (2);
+	for (i = 0; i < TIMED; i++)
+		values[i] = (int16_t) (rand () % 4096);
+
+	printf ("%-6s %-11s %10s %10s %10s %10s\n", "window", "call", "old nS", "new nS", "old cyc", "new cyc");
+	for (s = 0; s < (int) (sizeof (sizes) / sizeof (sizes[0])); s++)
+	{
+		int size = sizes[s];
+
+		TIMEIT (t[0][0], O, old_median_init, old_median_add, old_median_add (&O, values[i]));
+		TIMEIT (t[1][0], M, median_init, median_add, median_add (&M, values[i]));
+		TIMEIT (t[0][1], O, old_median_init, old_median_add, old_median_getMedian (&O, &v); sink = v);
+		TIMEIT (t[1][1], M, median_init, median_add, median_getMedian (&M, &v); sink = v);
+		TIMEIT (t[0][2], O, old_median_init, old_median_add, old_median_getAverage (&O, &v); sink = v);
+		TIMEIT (t[1][2], M, median_init, median_add, median_getAverage (&M, &v); sink = v);
+		TIMEIT (t[0][3], O, old_median_init, old_median_add,
+				  old_median_add (&O, values[i]); old_median_getMedian (&O, &v); sink = v; old_median_getAverage (&O, &v); sink = v);
+		TIMEIT (t[1][3], M, median_init, median_add,
+				  median_add (&M, values[i]); median_getMedian (&M, &v); sink = v; median_getAverage (&M, &v); sink = v);
+
+		for (c = 0; c < 4; c++)
+			printf ("%-6d %-11s %10.1f %10.1f %10.0f %10.0f\n", size, names[c], t[0][c].ns, t[1][c].ns, t[0][c].cycles,
+					  t[1][c].cycles);
+	}
+#if !HAVE_TSC
+	printf ("(no cycle counter on this machine)\n");
+#endif
+}
+
+int
+main (int argc, char **argv)
+{
+	long adds = (argc > 1) ? atol (argv[1]) : 200000;
+
+	if (adds <= 0)
+	{
+		fprintf (stderr, "usage: %s [adds]\n", argv[0]);
+		return 1;
+	}
+
+	if (!check (adds))
+		return 1;
+	bench ();
+	return 0;
+}
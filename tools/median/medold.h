@@ -0,0 +1,72 @@
+//---------------------------------------------------------------------------
+// Copyright (C) 2012 Robin Gilks (but see below for the original authors)
+//
+//
+//  medold.h   -   The median filter as it was before the sorted copy and sum were kept up to date in
+//                 median_add, so tools/median/medbench.c can check the current one against it
+//
+//  History:   1.0 - First release.
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+#ifndef _MEDOLD_H
+#define _MEDOLD_H
+
+// 
+//    FILE: RunningMedian.h
+//  AUTHOR: Rob dot Tillaart at gmail dot com  
+// PURPOSE: RunningMedian library for Arduino
+// VERSION: 0.2.00 - template edition
+//     URL: http://arduino.cc/playground/Main/RunningMedian
+// HISTORY: 0.2.00 first template version by Ronny
+//
+// Released to the public domain
+//
+
+#include <stdint.h>
+#include <stdbool.h>
+
+
+#define MIN_MEDIAN 1
+#define MAX_MEDIAN 20
+
+#define OK true
+#define NOK false
+
+typedef struct old_running_median {
+   int16_t ar[MAX_MEDIAN];
+   int16_t as[MAX_MEDIAN];
+   uint8_t idx;
+   uint8_t cnt;
+   uint8_t size;
+} OLD_MEDIAN;
+
+
+void old_median_init(OLD_MEDIAN *M,  uint8_t size);
+void old_median_clear(OLD_MEDIAN *M);
+void old_median_add(OLD_MEDIAN *M, int16_t value);
+bool old_median_getMedian(OLD_MEDIAN *M, int16_t * value);
+bool old_median_getAverage(OLD_MEDIAN *M, int16_t *value);
+bool old_median_getHighest(OLD_MEDIAN *M, int16_t *value);
+bool old_median_getLowest(OLD_MEDIAN *M, int16_t *value);
+uint8_t old_median_getSize(OLD_MEDIAN *M);
+uint8_t old_median_getCount(OLD_MEDIAN *M);
+bool old_median_getStatus(OLD_MEDIAN *M);
+bool old_median_getNext(OLD_MEDIAN *M, uint8_t *index, int16_t *value);
+uint8_t old_median_getStart(OLD_MEDIAN *M);
+
+
+#endif
+// --- END OF FILE ---
\ No newline at end of file
@@ -0,0 +1,66 @@
+//---------------------------------------------------------------------------
+// Copyright (C) 2012 Robin Gilks
+//
+//
+//  mkcurve.c   -   Generate the dump load PWM curve tables (curvetab.c)
+//
+//  History:   1.0 - First release.
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+// Build with:   cc -O2 -o mkcurve mkcurve.c -lm
+// Usage:        mkcurve > curvetab.c
+//
+// The dump load duty is 1010 * (shape^e - 1) / (shape - 1) for a normalised voltage error e of 0 to 1,
+// which starts gently and gets steeper the bigger the shape. One table is made for each shape in
+// CURVE_SHAPES (keep it in step with curve.h), with the duty scaled by 64 so the interpolation between
+// points on the AVR doesn't lose the fractions.
+
+#include <math.h>
+#include <stdio.h>
+
+#define CURVE_POINTS    257			  // 256 steps plus the end point
+#define CURVE_TOP       1010			  // highest OCR1A value, the load must still pulse
+#define CURVE_SCALE     64
+
+static const int shapes[] = { 15, 31, 63, 127 };
+
+int
+main (void)
+{
+	unsigned int s, i;
+
+	printf ("// Generated by tools/mkcurve.c - do not edit, change that and run it again\n\n");
+	printf ("#include <avr/pgmspace.h>\n\n#include \"curve.h\"\n\n");
+	printf ("const uint16_t curve_table[CURVE_SHAPES][CURVE_POINTS] PROGMEM = {\n");
+
+	for (s = 0; s < sizeof (shapes) / sizeof (shapes[0]); s++)
+	{
+		double shape = shapes[s];
+
+		printf ("\t// shape %d\n\t{", shapes[s]);
+		for (i = 0; i < CURVE_POINTS; i++)
+		{
+			double e = (double) i / (CURVE_POINTS - 1);
+			double duty = CURVE_TOP * (pow (shape, e) - 1) / (shape - 1);
+
+			if (i % 12 == 0)
+				printf ("\n\t\t");
+			printf ("%5ld,", lround (duty * CURVE_SCALE));
+		}
+		printf ("\n\t},\n");
+	}
+	printf ("};\n");
+	return 0;
+}
@@ -0,0 +1,169 @@
+//---------------------------------------------------------------------------
+// Copyright (C) 2012 Robin Gilks
+//
+//
+//  tlogdump.c   -   Turn a binary turbine log file back into text or CSV on the host
+//
+//  History:   1.0 - First release.
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+// Build with:   cc -O2 -o tlogdump tlogdump.c
+// Usage:        tlogdump [-c] [-u] log-YYMMDD.bin ...
+//               -c  CSV output with a heading line
+//               -u  US date format (month first)
+//
+// The file layout is defined by LOG_HEADER and LOG_RECORD in tlog.h. Fields are read a byte at a time
+// so this works whatever the endianness or struct packing of the host.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LOG_MAGIC       "TLOG"
+#define LOG_VERSION     1
+#define HEADER_SIZE     16
+#define RECORD_SIZE     32
+
+// flag bits, as tlog.h
+#define LOG_MASK_VALUE  0x1f
+#define LOG_ERROR       0x20
+#define LOG_SHUNT       0x40
+#define LOG_LOAD        0x80
+
+static int csv = 0;
+static int usdate = 0;
+
+// little endian 16 bit value from the record
+static int16_t
+get16 (const uint8_t * p)
+{
+	return (int16_t) (p[0] | (p[1] << 8));
+}
+
+static void
+print_record (const uint8_t * r)
+{
+	uint8_t day = r[0], month = r[1], year = r[2];
+	uint8_t hour = r[3], minute = r[4], second = r[5];
+	uint8_t flags = r[6];
+	int8_t dump = (int8_t) r[7];
+	int16_t volts = get16 (r + 8);
+	int16_t amps = get16 (r + 10);
+	int16_t charge = get16 (r + 12);
+	int16_t temp = get16 (r + 14);
+	int16_t rpm = get16 (r + 16);
+	int16_t maxrpm = get16 (r + 18);
+	int16_t maxhour = get16 (r + 20);
+	int16_t maxday = get16 (r + 22);
+	int16_t minhour = get16 (r + 24);
+	int16_t minday = get16 (r + 26);
+	uint16_t cca = (uint16_t) get16 (r + 28);
+	uint16_t dca = (uint16_t) get16 (r + 30);
+	// volts & amps are scaled by 100 each so loose 10,000
+	int16_t power = (int16_t) (((int32_t) amps * volts) / 10000);
+
+	if (csv)
+	{
+		printf ("20%02d-%02d-%02d %02d:%02d:%02d,%d,%d,%d,%d,", year, month, day, hour, minute, second,
+				  flags & LOG_ERROR ? 1 : 0, flags & LOG_LOAD ? 1 : 0, flags & LOG_SHUNT ? 1 : 0, flags & LOG_MASK_VALUE);
+		printf ("%d,%.2f,%d,%.2f,%.2f,%d,%d,%d,", dump, temp / 100.0, charge, volts / 100.0, amps / 100.0, power, rpm, maxrpm);
+		printf ("%d,%d,%d,%d,%u,%u\n", maxhour, maxday, minhour, minday, cca, dca);
+		return;
+	}
+
+	// the same as format_record in tlog.c
+	if (usdate)
+		printf ("%02d-%02d-%02d ", month, day, year);
+	else
+		printf ("%02d-%02d-%02d ", day, month, year);
+	printf ("%02d:%02d:%02d ", hour, minute, second);
+	printf ("E:%c L:%c S:%c F:%d ", flags & LOG_ERROR ? '1' : '0', flags & LOG_LOAD ? '1' : '0', flags & LOG_SHUNT ? '1' : '0', flags & LOG_MASK_VALUE);
+	printf ("D:%d T:%.*s%d.%02u C:%u ", dump, temp < 0 ? 1 : 0, "-", abs (temp / 100), abs (temp % 100), charge);
+	printf ("V:%d.%02u A:%.*s%d.%02u ", volts / 100, volts % 100, amps < 0 ? 1 : 0, "-", abs (amps / 100), abs (amps % 100));
+	printf ("P:%d R:%d r:%d H:%d Y:%d h:%d y:%d I:%u O:%u\r\n", power, rpm, maxrpm, maxhour, maxday, minhour, minday, cca, dca);
+}
+
+static int
+dump_file (const char *name)
+{
+	uint8_t header[HEADER_SIZE];
+	uint8_t record[256];
+	uint8_t header_size, record_size;
+	FILE *f;
+
+	f = fopen (name, "rb");
+	if (!f)
+	{
+		perror (name);
+		return 1;
+	}
+
+	if ((fread (header, 1, sizeof (header), f) != sizeof (header)) || (memcmp (header, LOG_MAGIC, 4) != 0))
+	{
+		fprintf (stderr, "%s: not a binary log file\n", name);
+		fclose (f);
+		return 1;
+	}
+
+	header_size = header[5];
+	record_size = header[6];
+	if ((header[4] > LOG_VERSION) || (header_size < HEADER_SIZE) || (record_size < RECORD_SIZE))
+	{
+		fprintf (stderr, "%s: unknown log version %d\n", name, header[4]);
+		fclose (f);
+		return 1;
+	}
+
+	fseek (f, header_size, SEEK_SET);
+	while (fread (record, 1, record_size, f) == record_size)
+		print_record (record);
+
+	fclose (f);
+	return 0;
+}
+
+int
+main (int argc, char *argv[])
+{
+	int i, res = 0, files = 0;
+
+	for (i = 1; i < argc; i++)
+	{
+		if (strcmp (argv[i], "-c") == 0)
+			csv = 1;
+		else if (strcmp (argv[i], "-u") == 0)
+			usdate = 1;
+	}
+
+	if (csv)
+		printf ("time,error,load,shunt,event,dump,temp,charge,volts,amps,power,rpm,maxrpm,maxhour,maxday,minhour,minday,cca,dca\n");
+
+	for (i = 1; i < argc; i++)
+	{
+		if (argv[i][0] == '-')
+			continue;
+		res |= dump_file (argv[i]);
+		files++;
+	}
+
+	if (files == 0)
+	{
+		fprintf (stderr, "usage: %s [-c] [-u] log-YYMMDD.bin ...\n", argv[0]);
+		return 1;
+	}
+
+	return res;
+}
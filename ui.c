@@ -58,6 +58,7 @@
 #include "eeprommap.h"
 #include "graph.h"
 #include "ui.h"
+#include "curve.h"
 
 
 
@@ -169,6 +170,7 @@ cal_inc (int8_t field, int8_t dirn)
 		gVoffset = 1.0;
 		break;
 	}
+	update_voffset ();
 	return 0;
 }
 
@@ -239,6 +241,13 @@ Vars variables[eNUMVARS] = {
 	{&gIdleCurrent, 0, 999, ddIdleCurrent, eDECIMAL, int_inc},      // idle current of controller, router etc
 	{&gAdjustTime, -719, 719, ddAdjustTime, eNORMAL, int_inc},      // clock adjuster
 	{&gUSdate, 0, 1, ddUsdate, eBOOLEAN, int_inc},                  // date format
+
+	{&gCurve, 0, CURVE_SHAPES - 1, ddCurve, eNORMAL, int_inc},      // dump load curve shape
+	{&gRegMode, 0, 1, ddRegMode, eBOOLEAN, int_inc},                // PI regulator instead of the curve
+	{&gKp, 0, 999, ddKp, eNORMAL, var_inc},                         // PI proportional gain
+	{&gKi, 0, 999, ddKi, eNORMAL, var_inc},                         // PI integral gain
+	{&gKd, 0, 999, ddKd, eNORMAL, var_inc},                         // PI derivative gain
+	{&gSlew, 1, 9999, ddSlew, eNORMAL, var_inc},                    // PI slew limit
 };
 
 
@@ -354,11 +363,23 @@ Screen control[] = {
 };
 
 
+Screen regulator[] = {
+	{-1, 0, 3, "Regulator", 0, 0},
+	{eCURVE, 1, 0, "Curve", 6, 1},
+	{eREGMODE, 1, 10, "PI", 15, 3},
+	{eKP, 2, 0, "Kp", 3, 3},
+	{eKI, 2, 10, "Ki", 13, 3},
+	{eKD, 3, 0, "Kd", 3, 3},
+	{eSLEW, 3, 10, "Slew", 15, 4},
+	{-2, 0, 0, "", 0, 0}
+};
+
+
 #define NUM_INFO 3
-#define NUM_SETUPS  5
+#define NUM_SETUPS  6
 #define MAXSCREENS  NUM_INFO + NUM_SETUPS
 
-static Screen *screen_list[] = { screen1, screen2, screen3, system, setup1, setup2, setup3, control };
+static Screen *screen_list[] = { screen1, screen2, screen3, system, setup1, setup2, setup3, control, regulator };
 
 
 static void set_month_day(uint8_t us)
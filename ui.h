@@ -73,6 +73,13 @@ enum VARS
 	eIDLE_CURRENT,
 	eADJUSTTIME,
 	eUSDATE,
+
+	eCURVE,
+	eREGMODE,
+	eKP,
+	eKI,
+	eKD,
+	eSLEW,
 	eNUMVARS
 };
 